@@ -26,6 +26,9 @@ src=(
 	${proj_root_dir}/src/kaneda/mem_debug.c
 	${proj_root_dir}/src/kaneda/file.c
 	${proj_root_dir}/src/kaneda/log.c
+	${proj_root_dir}/src/kaneda/arena.c
+	${proj_root_dir}/src/kaneda/pool.c
+	${proj_root_dir}/src/kaneda/pack.c
 )
 
 fworks=(
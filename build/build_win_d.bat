@@ -25,7 +25,10 @@ set src=^
 	%proj_root_dir%/src/kaneda/shader.c^
 	%proj_root_dir%/src/kaneda/mem_debug.c^
 	%proj_root_dir%/src/kaneda/file.c^
-	%proj_root_dir%/src/kaneda/log.c
+	%proj_root_dir%/src/kaneda/log.c^
+	%proj_root_dir%/src/kaneda/arena.c^
+	%proj_root_dir%/src/kaneda/pool.c^
+	%proj_root_dir%/src/kaneda/pack.c
 
 set libs=^
 	-lkernel32 ^
@@ -3,11 +3,19 @@ out vec4 FragColor;
 
 in vec2 TexCoord;
 
+#include "uniforms.glsl"
+
+#ifndef NO_TEXTURE
 // texture samplers
 uniform sampler2D texture1;
 uniform sampler2D texture2;
+#endif
 
 void main() {
+#ifdef NO_TEXTURE
+    FragColor = color;
+#else
     // linearly interpolate between both textures (80% container, 20% awesomeface)
     FragColor = mix(texture(texture1, TexCoord), texture(texture2, TexCoord), 0.2);
+#endif
 }
\ No newline at end of file
@@ -4,11 +4,9 @@ layout(location = 1) in vec2 aTexCoord;
 
 out vec2 TexCoord;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "uniforms.glsl"
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    gl_Position = view_projection * model * vec4(aPos, 1.0f);
     TexCoord = vec2(aTexCoord.x, aTexCoord.y);
 }
\ No newline at end of file
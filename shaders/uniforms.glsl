@@ -0,0 +1,13 @@
+// The Frame and Object blocks, FrameUniforms and ObjectUniforms on the C side.
+layout(std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    mat4 view_projection;
+    vec4 camera_position;
+    vec4 time;
+};
+
+layout(std140) uniform Object {
+    mat4 model;
+    vec4 color;
+};
@@ -0,0 +1,51 @@
+#include "core.h"
+#include "log.h"
+
+static thread_local Arena frame_arena = {0};
+static thread_local Arena scratch_arena = {0};
+
+bool arena_create(Arena *arena, usize size) {
+    // One big malloc, the OS only backs the pages that actually get touched.
+    *arena = (Arena){.base = malloc(size), .size = size};
+    if (arena->base == NULL) {
+        log_fatal("Unable to reserve %zu bytes for an arena.\n", size);
+        arena->size = 0;
+        return false;
+    }
+    return true;
+}
+
+void arena_destroy(Arena *arena) {
+    free(arena->base);
+    *arena = (Arena){0};
+}
+
+void *arena_overflow(Arena *arena, usize size) {
+    log_error("Arena out of space: %zu bytes requested with %zu of %zu used.\n", size, arena->used,
+              arena->size);
+    return NULL;
+}
+
+static Arena *arena_thread(Arena *arena, usize size) {
+    if (arena->base == NULL) {
+        arena_create(arena, size);
+    }
+    return arena;
+}
+
+Arena *arena_frame(void) {
+    return arena_thread(&frame_arena, FRAME_ARENA_SIZE);
+}
+
+Arena *arena_scratch(void) {
+    return arena_thread(&scratch_arena, SCRATCH_ARENA_SIZE);
+}
+
+void arena_frame_reset(void) {
+    arena_reset(&frame_arena);
+}
+
+void arena_thread_release(void) {
+    arena_destroy(&frame_arena);
+    arena_destroy(&scratch_arena);
+}
@@ -9,22 +9,15 @@ static void glfw_error_callback(int error, const char *description) {
 }
 
 static LRESULT CALLBACK win32_message(HWND hwnd, UINT umsg, WPARAM wparam, LPARAM lparam) {
-    if (umsg == WM_KEYDOWN) {
-        input()->keyboard.key_state_current[(unsigned int)wparam] = 1;
-    } else if (umsg == WM_KEYUP) {
-        input()->keyboard.key_state_current[(unsigned int)wparam] = 0;
-    } else {
+    if (umsg != WM_KEYDOWN && umsg != WM_KEYUP) {
         return DefWindowProc(hwnd, umsg, wparam, lparam);
     }
 
-    // Check if there is space available in the key queue
-    if ((input()->keyboard.num_keys_pressed < MAX_KEYS_PRESSABLE) && (umsg == WM_KEYUP)) {
-        // Add character to the queue
-        input()->keyboard.key_pressed_queue[input()->keyboard.num_keys_pressed] =
-            (unsigned int)wparam;
-        input()->keyboard.num_keys_pressed++;
-    }
-
+    input_push_event(&input()->queue,
+                     (InputEvent){.time = time_elapsed(),
+                                  .type = INPUT_EVENT_KEY,
+                                  .code = (int32)wparam,
+                                  .action = umsg == WM_KEYDOWN ? GLFW_PRESS : GLFW_RELEASE});
     return 0;
 }
 
@@ -53,6 +46,10 @@ static LRESULT CALLBACK win32_wndproc_callback(HWND hwnd, UINT umessage, WPARAM
 // GLFW3 WindowSize Callback, runs when window is resizedLastFrame
 static void callback_window_size(GLFWwindow *window, int width, int height) {
     Platform *platform = engine()->platform;
+    input_push_event(&input()->queue,
+                     (InputEvent){.time = time_elapsed(),
+                                  .type = INPUT_EVENT_WINDOW_RESIZE,
+                                  .value = math_vec2((float)width, (float)height)});
 
     platform->window.render_size.width = width;
     platform->window.render_size.height = height;
@@ -74,57 +71,68 @@ static void callback_window_size(GLFWwindow *window, int width, int height) {
 
 // GLFW3 WindowMaximize Callback, runs when window is maximized/restored
 static void callback_window_maximize(GLFWwindow *window, int maximized) {
+    input_push_event(&input()->queue, (InputEvent){.time = time_elapsed(),
+                                                   .type = INPUT_EVENT_WINDOW_MAXIMIZE,
+                                                   .action = maximized});
 }
 
 // GLFW3 WindowIconify Callback, runs when window is minimized/restored
 static void callback_window_iconify(GLFWwindow *window, int iconified) {
+    input_push_event(&input()->queue, (InputEvent){.time = time_elapsed(),
+                                                   .type = INPUT_EVENT_WINDOW_ICONIFY,
+                                                   .action = iconified});
 }
 
 // GLFW3 WindowFocus Callback, runs when window get/lose focus
 static void callback_window_focus(GLFWwindow *window, int focused) {
+    input_push_event(&input()->queue, (InputEvent){.time = time_elapsed(),
+                                                   .type = INPUT_EVENT_WINDOW_FOCUS,
+                                                   .action = focused});
 }
 // ----------------------------------------------
 
 // mouse callbacks ------------------------------
+// Input callbacks only queue events, the state in Input is updated when the queue is drained.
 static void callback_mouse_button(GLFWwindow *window, int button, int action, int mods) {
-    input()->mouse.button_state_current[button] = action;
+    input_push_event(&input()->queue, (InputEvent){.time = time_elapsed(),
+                                                   .type = INPUT_EVENT_MOUSE_BUTTON,
+                                                   .code = button,
+                                                   .action = action});
 }
 
 static void callback_cursor_pos(GLFWwindow *window, double x_pos, double y_pos) {
-    input()->mouse.position = math_vec2((float)x_pos, (float)y_pos);
+    input_push_event(&input()->queue,
+                     (InputEvent){.time = time_elapsed(),
+                                  .type = INPUT_EVENT_MOUSE_MOVE,
+                                  .value = math_vec2((float)x_pos, (float)y_pos)});
 }
 
 static void callback_mouse_scroll(GLFWwindow *window, double x_offset, double y_offset) {
-    input()->mouse.wheel_move_current = (float)y_offset;
+    input_push_event(&input()->queue,
+                     (InputEvent){.time = time_elapsed(),
+                                  .type = INPUT_EVENT_MOUSE_SCROLL,
+                                  .value = math_vec2((float)x_offset, (float)y_offset)});
 }
 
 static void callback_cursor_enter(GLFWwindow *window, int enter) {
-    input()->mouse.is_cursor_inside_client = enter ? true : false;
+    input_push_event(&input()->queue, (InputEvent){.time = time_elapsed(),
+                                                   .type = INPUT_EVENT_CURSOR_ENTER,
+                                                   .action = enter});
 }
 // ----------------------------------------------
 
 // keyboard callbacks ---------------------------
 static void callback_key(GLFWwindow *window, int key, int scancode, int action, int mods) {
-    if (action == GLFW_RELEASE) {
-        input()->keyboard.key_state_current[key] = 0;
-    } else {
-        input()->keyboard.key_state_current[key] = 1;
-    }
-
-    // Check if there is space available in the key queue
-    if ((input()->keyboard.num_keys_pressed < MAX_KEYS_PRESSABLE) && (action == GLFW_RELEASE)) {
-        // Add character to the queue
-        input()->keyboard.key_pressed_queue[input()->keyboard.num_keys_pressed] = key;
-        input()->keyboard.num_keys_pressed++;
-    }
+    input_push_event(&input()->queue, (InputEvent){.time = time_elapsed(),
+                                                   .type = INPUT_EVENT_KEY,
+                                                   .code = key,
+                                                   .action = action});
 }
 
 static void callback_char(GLFWwindow *window, unsigned int key) {
-    if (input()->keyboard.num_chars_pressed < MAX_CHAR_PRESSED_QUEUE) {
-        // Add character to the queue
-        input()->keyboard.char_pressed_queue[input()->keyboard.num_chars_pressed] = key;
-        input()->keyboard.num_chars_pressed++;
-    }
+    input_push_event(&input()->queue, (InputEvent){.time = time_elapsed(),
+                                                   .type = INPUT_EVENT_CHAR,
+                                                   .code = (int32)key});
 }
 // ----------------------------------------------
 
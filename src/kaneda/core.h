@@ -22,7 +22,9 @@
 #endif
 
 #if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+#include <pthread.h>
 #include <sched.h>
+#include <time.h>
 #include <unistd.h>
 #elif (defined PLATFORM_WINDOWS)
 #include <Windows.h>
@@ -33,6 +35,8 @@
 #include <GLFW/glfw3.h>
 
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
 #ifdef PLATFORM_WINDOWS
 typedef unsigned int uint;
@@ -58,33 +62,76 @@ typedef double float64;
 /* Defines PI */
 #define PI 3.1415926535897932384626433832795028841971693993751058209749445923
 
-#ifndef NO_MEMORY_DEBUG // currently broken w/ stb_image :(
+#ifndef NO_MEMORY_DEBUG
 //#define MEMORY_DEBUG /* turns on the memory debugging system */
 #endif
 #ifndef EXIT_CRASH
 //#define EXIT_CRASH /* turns on crash on exit */
 #endif
+#ifndef NO_PROFILER
+#define PROFILER /* turns on the frame zone profiler */
+#endif
+
+#if (defined _MSC_VER)
+#define thread_local __declspec(thread)
+#else
+#define thread_local __thread
+#endif
+
+/* ----- Memory tags -----
+Every allocation is charged to the subsystem that was tagged on the allocating thread when it was
+made. Tags nest: push one around a chunk of work and pop it when done. Untagged work is GENERAL. */
+
+typedef enum MemTag {
+    MEM_TAG_GENERAL,
+    MEM_TAG_PLATFORM,
+    MEM_TAG_GRAPHICS,
+    MEM_TAG_AUDIO,
+    MEM_TAG_ASSETS,
+    MEM_TAG_GAME,
+    MEM_TAG_UI,
+    MEM_TAG_COUNT
+} MemTag;
+
+typedef struct MemTagStats {
+    usize bytes;        // currently allocated
+    usize peak;         // high-water mark of bytes
+    usize budget;       // bytes this tag is expected to stay under, 0 for no budget
+    uint64 allocations; // allocations made so far
+    uint64 frees;       // frees made so far
+} MemTagStats;
+
+extern const char *mem_tag_names[MEM_TAG_COUNT];
+extern void mem_tag_push(MemTag tag); /* Charges the calling thread's allocations to `tag`. */
+extern void mem_tag_pop(void);        /* Goes back to the tag before the last push. */
+extern MemTag mem_tag_current(void);
 
 #ifdef MEMORY_DEBUG
 /* ----- Debugging -----
 If MEMORY_DEBUG  is enabled, the memory debugging system will create macros that replace malloc,
-free and realloc and allows the system to kept track of and report where memory is being allocated,
-how much and if the memory is being fred. This is very useful for finding memory leaks in large
-applications. The system can also over allocate memory and fill it with a magic number and can
-therfor detect if the application writes outside of the allocated memory. if EXIT_CRASH is defined,
-then exit(); will be replaced with a funtion that writes to NULL. This will make it trivial ti find
-out where an application exits using any debugger., */
-
-extern void debug_memory_init(void (*lock)(void *mutex), void (*unlock)(void *mutex),
-                              void *mutex); /* Required for memory debugger to be thread safe */
+calloc, free and realloc and allows the system to kept track of and report where memory is being
+allocated, how much and if the memory is being fred. This is very useful for finding memory leaks in
+large applications. The system can also over allocate memory and fill it with a magic number and can
+therfor detect if the application writes outside of the allocated memory. Allocations are looked up
+in a hash table keyed by pointer and call sites in one keyed by file and line, so a free costs the
+same no matter how much is alive and the tracker can stay on through long soak runs. if EXIT_CRASH
+is defined, then exit(); will be replaced with a funtion that writes to NULL. This will make it
+trivial ti find out where an application exits using any debugger., */
+
+extern void debug_memory_init(
+    void (*lock)(void *mutex), void (*unlock)(void *mutex),
+    void *mutex); /* Replaces the built in lock, on POSIX the tracker is thread safe without it */
 extern void *debug_mem_malloc(
-    uint size, char *file,
+    usize size, const char *file,
     uint line); /* Replaces malloc and records the c file and line where it was called*/
+extern void *debug_mem_calloc(
+    usize count, usize size, const char *file,
+    uint line); /* Replaces calloc and records the c file and line where it was called*/
 extern void *debug_mem_realloc(
-    void *pointer, uint size, char *file,
+    void *pointer, usize size, const char *file,
     uint line); /* Replaces realloc and records the c file and line where it was called*/
-extern void
-debug_mem_free(void *buf); /* Replaces free and records the c file and line where it was called*/
+extern void debug_mem_free(
+    void *buf); /* Replaces free, freeing NULL is fine and unknown pointers are reported */
 extern void debug_mem_print(
     uint min_allocs); /* Prints out a list of all allocations made, their location, how much memorey
                          each has allocated, freed, and how many allocations have been made. The
@@ -96,8 +143,16 @@ extern void debug_mem_reset(
 extern bool debug_memory(
     void); /* debug_memory checks if any of the bounds of any allocation has been over written and
               reports where to standard out. The function returns TRUE if any error was found*/
+extern usize debug_mem_consumption(void); /* Bytes currently allocated through the tracker. */
+extern void debug_mem_set_budget(
+    MemTag tag, usize bytes); /* Warns whenever `tag` goes over `bytes`, 0 turns the warning off */
+extern MemTagStats debug_mem_tag_stats(MemTag tag);
+extern void debug_mem_frame(
+    uint64 *allocations,
+    uint64 *bytes); /* Allocations and bytes since the last call, from every thread */
 
 #define malloc(n) debug_mem_malloc(n, __FILE__, __LINE__)         /* Replaces malloc. */
+#define calloc(n, m) debug_mem_calloc(n, m, __FILE__, __LINE__)   /* Replaces calloc. */
 #define realloc(n, m) debug_mem_realloc(n, m, __FILE__, __LINE__) /* Replaces realloc. */
 #define free(n) debug_mem_free(n)                                 /* Replaces free. */
 
@@ -108,6 +163,10 @@ extern void exit_crash(uint i); /* function guaranteed to crash (Writes to NULL)
 #define exit(n) exit_crash(n)   /* overwriting exit(0) with a function guaraneed to crash. */
 #endif
 
+#ifndef MAX_KEYBOARD_KEYS
+#define MAX_KEYBOARD_KEYS 512 // Key codes tracked by the keyboard bitsets (multiple of 64)
+#endif
+#define KEY_BITSET_WORDS (MAX_KEYBOARD_KEYS / 64)
 #ifndef MAX_GAMEPADS
 #define MAX_GAMEPADS 4 // Max number of gamepads supported
 #endif
@@ -123,6 +182,69 @@ extern void exit_crash(uint i); /* function guaranteed to crash (Writes to NULL)
 #ifndef MAX_KEYS_PRESSABLE
 #define MAX_KEYS_PRESSABLE 16 // Max number of keys in the key input queue
 #endif
+#ifndef INPUT_EVENT_QUEUE_SIZE
+#define INPUT_EVENT_QUEUE_SIZE 4096 // Events the producer can run ahead of a drain (power of two)
+#endif
+#ifndef FRAME_ARENA_SIZE
+#define FRAME_ARENA_SIZE (16 * 1024 * 1024) // Bytes each thread's frame arena can hand out
+#endif
+#ifndef SCRATCH_ARENA_SIZE
+#define SCRATCH_ARENA_SIZE (4 * 1024 * 1024) // Bytes each thread's scratch arena can hand out
+#endif
+#ifndef MAX_MESHES
+#define MAX_MESHES 4096 // Max number of meshes alive at once
+#endif
+#ifndef MAX_TEXTURES
+#define MAX_TEXTURES 4096 // Max number of textures alive at once
+#endif
+#ifndef MAX_SHADERS
+#define MAX_SHADERS 256 // Max number of shader programs alive at once
+#endif
+#ifndef JOB_QUEUE_SIZE
+#define JOB_QUEUE_SIZE 4096 // Jobs each thread can have queued (must be a power of two)
+#endif
+#ifndef JOB_MAX_THREADS
+#define JOB_MAX_THREADS 64 // Max number of threads that can queue or run jobs
+#endif
+#ifndef IO_QUEUE_SIZE
+#define IO_QUEUE_SIZE 256 // File reads that can be in flight at once (must be a power of two)
+#endif
+#ifndef IO_WORKER_COUNT
+#define IO_WORKER_COUNT 2 // Threads doing blocking reads when io_uring isn't available
+#endif
+#ifndef UNIFORM_BUFFER_SIZE
+#define UNIFORM_BUFFER_SIZE (1024 * 1024) // Bytes of uniform blocks each frame can write
+#endif
+#ifndef UNIFORM_BUFFER_FRAMES
+#define UNIFORM_BUFFER_FRAMES 3 // Frames of uniform blocks the GPU can still be reading
+#endif
+#ifndef RENDER_QUEUE_SIZE
+#define RENDER_QUEUE_SIZE 16384 // Draws the render queue can hold between flushes
+#endif
+#ifndef SHADER_CACHE_DIR
+#define SHADER_CACHE_DIR "build/shader_cache" // Where linked program binaries are cached
+#endif
+#ifndef SHADER_WATCH_MAX_DIRS
+#define SHADER_WATCH_MAX_DIRS 16 // Directories of shader sources hot reload can watch
+#endif
+#ifndef GPU_TIMER_LATENCY
+#define GPU_TIMER_LATENCY 3 // Frames a GPU timer query is left in flight before it is read back
+#endif
+#ifndef GPU_TIMER_MAX_PASSES
+#define GPU_TIMER_MAX_PASSES 16 // Max number of named GPU passes
+#endif
+#ifndef PROFILER_RING_SIZE
+#define PROFILER_RING_SIZE 16384 // Zones kept per thread (must be a power of two)
+#endif
+#ifndef PROFILER_MAX_DEPTH
+#define PROFILER_MAX_DEPTH 32 // Max nesting of zones on one thread
+#endif
+#ifndef PROFILER_COUNTER_RING_SIZE
+#define PROFILER_COUNTER_RING_SIZE 16384 // Counter samples kept per thread (must be a power of two)
+#endif
+#ifndef PROFILER_MAX_THREADS
+#define PROFILER_MAX_THREADS 64 // Max number of threads that can record zones
+#endif
 
 #include "math.h"
 
@@ -208,6 +330,137 @@ static inline void *_kamalloc_init_impl(size_t sz) {
     memset(data, 0, sz);
     return data;
 }
+#ifdef MEMORY_DEBUG
+// Charge the caller's line rather than this header's.
+#define kamalloc_init(__TYPE) (__TYPE *)calloc(1, sizeof(__TYPE))
+#else
 #define kamalloc_init(__TYPE) (__TYPE *)_kamalloc_init_impl(sizeof(__TYPE))
+#endif
+
+/* ----- Arenas -----
+A bump allocator over one up-front block. Pushing is an add and a compare, popping back to an
+earlier mark frees everything pushed since in one go, and nothing is ever freed individually.
+Every thread gets two of its own, so none of this needs a lock:
+    arena_frame()   lives until the end of the frame. engine_frame() resets the main thread's, the
+                    sim thread resets its own after every step and job workers after every job.
+    arena_scratch() for work inside one function. Take a mark, push, pop back to the mark before
+                    returning. */
+
+typedef struct Arena {
+    uint8 *base;
+    usize size; // bytes reserved
+    usize used; // bytes handed out, including alignment padding
+    usize peak; // most bytes ever in use at once
+} Arena;
+
+#define ARENA_DEFAULT_ALIGN 16
+
+extern bool arena_create(Arena *arena, usize size);
+extern void arena_destroy(Arena *arena);
+extern void *arena_overflow(Arena *arena, usize size); /* Logs the overflow, returns NULL. */
+extern Arena *arena_frame(void);                       /* The calling thread's frame arena. */
+extern Arena *arena_scratch(void);                     /* The calling thread's scratch arena. */
+extern void arena_frame_reset(void);     /* Empties the calling thread's frame arena. */
+extern void arena_thread_release(void); /* Frees the calling thread's arenas, call on thread exit. */
+
+/* Returns `size` bytes aligned to `align` (a power of two), or NULL once the arena is full. */
+static inline void *arena_push_aligned(Arena *arena, usize size, usize align) {
+    usize offset = (arena->used + (align - 1)) & ~(align - 1);
+    if (offset + size > arena->size) {
+        return arena_overflow(arena, size);
+    }
+    arena->used = offset + size;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    return arena->base + offset;
+}
+
+static inline void *arena_push(Arena *arena, usize size) {
+    return arena_push_aligned(arena, size, ARENA_DEFAULT_ALIGN);
+}
+
+static inline void *arena_push_zero(Arena *arena, usize size) {
+    void *data = arena_push(arena, size);
+    if (data != NULL) {
+        memset(data, 0, size);
+    }
+    return data;
+}
+#define arena_push_init(__ARENA, __TYPE) (__TYPE *)arena_push_zero(__ARENA, sizeof(__TYPE))
+#define arena_push_array(__ARENA, __TYPE, __COUNT)                                                 \
+    (__TYPE *)arena_push_aligned(__ARENA, sizeof(__TYPE) * (__COUNT), __alignof__(__TYPE))
+
+/* Marks where the arena is now, arena_pop() rewinds back to it. */
+static inline usize arena_mark(Arena *arena) {
+    return arena->used;
+}
+
+static inline void arena_pop(Arena *arena, usize mark) {
+    if (mark < arena->used) {
+        arena->used = mark;
+    }
+}
+
+static inline void arena_reset(Arena *arena) {
+    arena->used = 0;
+}
+
+/* ----- Pools -----
+Fixed capacity storage for objects of one size, allocated once up front and recycled through a
+free list. Objects are referred to by 32 bit handles: the slot index in the low POOL_INDEX_BITS
+and the slot's generation above it. Freeing a slot bumps its generation, so a stale handle stops
+resolving instead of pointing at whatever moved in after it. A handle of 0 is never valid.
+Live slots are also kept packed in `dense`, so walking every live object touches nothing else:
+    for (uint32 i = 0; i < pool->count; i++) { Thing *thing = pool_at(pool, i); } */
+
+#define POOL_INDEX_BITS 20
+#define POOL_INDEX_MASK ((1u << POOL_INDEX_BITS) - 1)
+#define POOL_GENERATION_MASK ((1u << (32 - POOL_INDEX_BITS)) - 1)
+#define POOL_HANDLE_NULL 0
+
+typedef struct Pool {
+    const char *name;    // shows up in the log when the pool runs out
+    uint8 *data;         // capacity slots of item_size bytes, back to back
+    uint16 *generations; // current generation of every slot, never 0
+    uint32 *sparse;      // live slots: position in dense, free slots: next free slot
+    uint32 *dense;       // indices of the live slots, packed
+    uint32 item_size;    // bytes per slot, rounded up to keep every slot 16 byte aligned
+    uint32 capacity;
+    uint32 count; // live slots
+    uint32 free_head;
+} Pool;
+
+extern bool pool_create(Pool *pool, const char *name, uint32 item_size, uint32 capacity);
+extern void pool_destroy(Pool *pool);
+extern uint32 pool_alloc(Pool *pool);              /* Zeroed slot, POOL_HANDLE_NULL when full. */
+extern bool pool_free(Pool *pool, uint32 handle); /* False if the handle was already stale. */
+
+static inline uint32 pool_handle_index(uint32 handle) {
+    return handle & POOL_INDEX_MASK;
+}
+
+static inline uint32 pool_handle_generation(uint32 handle) {
+    return handle >> POOL_INDEX_BITS;
+}
+
+/* The object behind `handle`, or NULL if it has been freed since. */
+static inline void *pool_get(Pool *pool, uint32 handle) {
+    uint32 index = pool_handle_index(handle);
+    if (index >= pool->capacity || pool->generations[index] != pool_handle_generation(handle)) {
+        return NULL;
+    }
+    return pool->data + (usize)index * pool->item_size;
+}
+
+/* The i-th live object, for i in [0, count). Order changes whenever something is freed. */
+static inline void *pool_at(Pool *pool, uint32 i) {
+    return pool->data + (usize)pool->dense[i] * pool->item_size;
+}
+
+static inline uint32 pool_handle_at(Pool *pool, uint32 i) {
+    uint32 index = pool->dense[i];
+    return ((uint32)pool->generations[index] << POOL_INDEX_BITS) | index;
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef ENTITY_H
+#define ENTITY_H
+
+#include "core.h"
+
+/*
+███████╗███╗   ██╗████████╗██╗████████╗██╗   ██╗
+██╔════╝████╗  ██║╚══██╔══╝██║╚══██╔══╝╚██╗ ██╔╝
+█████╗  ██╔██╗ ██║   ██║   ██║   ██║    ╚████╔╝
+██╔══╝  ██║╚██╗██║   ██║   ██║   ██║     ╚██╔╝
+███████╗██║ ╚████║   ██║   ██║   ██║      ██║
+╚══════╝╚═╝  ╚═══╝   ╚═╝   ╚═╝   ╚═╝      ╚═╝
+The engine doesn't know what an entity is, only how big one is. Game.entity_size and
+Game.max_entities size a pool up front, before init() runs, and the game casts what it gets back
+to its own struct. Entities never move, so a pointer from entity_get() stays good until that
+entity is destroyed, but keep handles in anything that outlives it: the slot gets reused. An
+index for entity_at() is what goes stale, destroying an entity moves the last one into its place.
+To update everything that's alive:
+    for (uint32 i = 0; i < entity_count(); i++) { Enemy *enemy = entity_at(i); }
+*/
+
+// A zeroed entity, or a null handle when the pool is full or the game never asked for one.
+EntityHandle entity_create(void) {
+    Pool *entities = &engine()->entities;
+    EntityHandle handle = {entities->capacity > 0 ? pool_alloc(entities) : POOL_HANDLE_NULL};
+    return handle;
+}
+
+// NULL once the entity has been destroyed, even if its slot has been reused since.
+void *entity_get(EntityHandle handle) {
+    return pool_get(&engine()->entities, handle.id);
+}
+
+void entity_destroy(EntityHandle handle) {
+    pool_free(&engine()->entities, handle.id);
+}
+
+uint32 entity_count(void) {
+    return engine()->entities.count;
+}
+
+void *entity_at(uint32 i) {
+    return pool_at(&engine()->entities, i);
+}
+
+EntityHandle entity_handle_at(uint32 i) {
+    EntityHandle handle = {pool_handle_at(&engine()->entities, i)};
+    return handle;
+}
+
+#endif
@@ -1,7 +1,11 @@
 #include "file.h"
 #include "log.h"
 
-#include <assert.h>
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
 
 static void validate_file(file f) {
     if (f == NULL) {
@@ -14,73 +18,89 @@ file file_open(const char *path, file_mode mode) {
     file f = malloc(sizeof(struct file));
     *f = (struct file){.path = path};
 
-    const char *file_mode_str = "";
+    // Reads and writes are positional, so there's no cursor and text and binary modes are the same
+    // thing. Append modes still write at the end no matter the offset.
+#ifdef PLATFORM_WINDOWS
+    DWORD access = 0;
+    DWORD creation = 0;
+#else
+    int flags = 0;
+#endif
     switch (mode) {
     case FILE_MODE_READ:
-        file_mode_str = "r";
-        break;
     case FILE_MODE_READ_BINARY:
-        file_mode_str = "rb";
+#ifdef PLATFORM_WINDOWS
+        access = GENERIC_READ;
+        creation = OPEN_EXISTING;
+#else
+        flags = O_RDONLY;
+#endif
         break;
     case FILE_MODE_WRITE:
-        file_mode_str = "w";
-        break;
     case FILE_MODE_WRITE_BINARY:
-        file_mode_str = "wb";
+#ifdef PLATFORM_WINDOWS
+        access = GENERIC_WRITE;
+        creation = CREATE_ALWAYS;
+#else
+        flags = O_WRONLY | O_CREAT | O_TRUNC;
+#endif
         break;
     case FILE_MODE_APPEND:
-        file_mode_str = "a";
-        break;
     case FILE_MODE_APPEND_BINARY:
-        file_mode_str = "ab";
+#ifdef PLATFORM_WINDOWS
+        access = FILE_APPEND_DATA;
+        creation = OPEN_ALWAYS;
+#else
+        flags = O_WRONLY | O_CREAT | O_APPEND;
+#endif
         break;
     case FILE_MODE_READ_WRITE:
-        file_mode_str = "r+";
-        break;
     case FILE_MODE_READ_WRITE_BINARY:
-        file_mode_str = "r+b";
+#ifdef PLATFORM_WINDOWS
+        access = GENERIC_READ | GENERIC_WRITE;
+        creation = OPEN_EXISTING;
+#else
+        flags = O_RDWR;
+#endif
         break;
     default:
         log_fatal("Trying to open a file with an unknown FileMode %i.\n", mode);
         exit(1);
     }
 
-    f->fp = fopen(path, file_mode_str);
-    if (f->fp == NULL) {
+#ifdef PLATFORM_WINDOWS
+    f->handle = CreateFile(path, access, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, creation,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (f->handle == INVALID_HANDLE_VALUE) {
         log_fatal("Trying to open file %s that doesn't exist.\n", path);
         exit(1);
     }
 
-#ifdef PLATFORM_WINDOWS
-    HANDLE h_file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
-                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (h_file == INVALID_HANDLE_VALUE) {
-        return -1; // error condition, could call GetLastError to find out more
-    }
-
     LARGE_INTEGER size;
-    if (!GetFileSizeEx(h_file, &size)) {
-        CloseHandle(h_file);
-        return -1; // error condition, could call GetLastError to find out more
+    if (!GetFileSizeEx(f->handle, &size)) {
+        log_fatal("Unable to get the size of file %s.\n", path);
+        exit(1);
     }
-
-    CloseHandle(h_file);
-    assert(size.QuadPart <= 0xFFFFFFFF);
-    f->size = (uint32)size.QuadPart;
+    f->size = (uint64)size.QuadPart;
 #else
+    f->fd = open(path, flags, 0644);
+    if (f->fd < 0) {
+        log_fatal("Trying to open file %s that doesn't exist.\n", path);
+        exit(1);
+    }
+
     struct stat st;
-    stat(path, &st);
-    f->size = (uint32)st.st_size;
+    if (fstat(f->fd, &st) != 0) {
+        log_fatal("Unable to get the size of file %s.\n", path);
+        exit(1);
+    }
+    f->size = (uint64)st.st_size;
 #endif
 
-    // fseek(f->fp, 0, SEEK_END);
-    // f->size = ftell(f->fp);
-    // fseek(f->fp, 0, SEEK_SET);
-
     return f;
 }
 
-uint32 file_get_size(file f) {
+uint64 file_get_size(file f) {
     validate_file(f);
     return f->size;
 }
@@ -90,13 +110,14 @@ const char *file_get_path(file f) {
     return f->path;
 }
 
-void file_read(file f, uint32 offset, uint32 size, void *data) {
+uint64 file_read(file f, uint64 offset, uint64 size, void *data) {
     validate_file(f);
 
     if (offset > f->size) {
-        log_fatal("Trying to read from the file, but offset + size (%l + %l) is outside the bounds "
-                  "of the file size %l.\n",
-                  offset, size, f->size);
+        log_fatal("Trying to read from the file, but offset + size (%llu + %llu) is outside the "
+                  "bounds of the file size %llu.\n",
+                  (unsigned long long)offset, (unsigned long long)size,
+                  (unsigned long long)f->size);
         exit(1);
     }
     if (data == NULL) {
@@ -105,29 +126,78 @@ void file_read(file f, uint32 offset, uint32 size, void *data) {
         exit(1);
     }
 
-    fseek(f->fp, offset, SEEK_SET);
-    fread(data, size, 1, f->fp); /* This is probably wrong. */
-    fseek(f->fp, 0, SEEK_SET);
+    // One call may come up short, keep going until everything asked for is in or the file ends.
+    uint64 done = 0;
+    while (done < size) {
+#ifdef PLATFORM_WINDOWS
+        uint64 at = offset + done;
+        OVERLAPPED overlapped = {.Offset = (DWORD)at, .OffsetHigh = (DWORD)(at >> 32)};
+        DWORD chunk = size - done > 0x40000000 ? 0x40000000 : (DWORD)(size - done);
+        DWORD count = 0;
+        if (!ReadFile(f->handle, (uint8 *)data + done, chunk, &count, &overlapped) || count == 0) {
+            break;
+        }
+#else
+        ssize_t count = pread(f->fd, (uint8 *)data + done, (usize)(size - done),
+                              (off_t)(offset + done));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+#endif
+        done += (uint64)count;
+    }
+    return done;
 }
 
-void file_write(file f, uint32 offset, uint32 size, void *data) {
+uint64 file_write(file f, uint64 offset, uint64 size, void *data) {
     validate_file(f);
     if (offset > f->size) {
-        log_fatal("Trying to write to the file, but offset + size (%l + %l) is outside the bounds "
-                  "of the file size %l.\n",
-                  offset, size, f->size);
+        log_fatal("Trying to write to the file, but offset + size (%llu + %llu) is outside the "
+                  "bounds of the file size %llu.\n",
+                  (unsigned long long)offset, (unsigned long long)size,
+                  (unsigned long long)f->size);
         exit(1);
     }
     if (data == NULL) {
         log_fatal("Trying to copy data from the pointer into the file, but the supplied pointer is "
-                  "NULL.\n",
-                  f);
+                  "NULL.\n");
         exit(1);
     }
 
-    fseek(f->fp, offset, SEEK_SET);
-    fwrite(data, size, 1, f->fp); /* this is also probably wrong... */
-    fseek(f->fp, 0, SEEK_SET);
+    uint64 done = 0;
+    while (done < size) {
+#ifdef PLATFORM_WINDOWS
+        uint64 at = offset + done;
+        OVERLAPPED overlapped = {.Offset = (DWORD)at, .OffsetHigh = (DWORD)(at >> 32)};
+        DWORD chunk = size - done > 0x40000000 ? 0x40000000 : (DWORD)(size - done);
+        DWORD count = 0;
+        if (!WriteFile(f->handle, (uint8 *)data + done, chunk, &count, &overlapped) ||
+            count == 0) {
+            break;
+        }
+#else
+        ssize_t count = pwrite(f->fd, (uint8 *)data + done, (usize)(size - done),
+                               (off_t)(offset + done));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+#endif
+        done += (uint64)count;
+    }
+    if (done < size) {
+        log_error("Only wrote %llu of %llu bytes to %s.\n", (unsigned long long)done,
+                  (unsigned long long)size, f->path);
+    }
+    if (offset + done > f->size) {
+        f->size = offset + done;
+    }
+    return done;
 }
 
 bool file_exists(const char *path) {
@@ -142,10 +212,147 @@ bool file_exists(const char *path) {
 
 void file_close(file f) {
     validate_file(f);
-    fclose(f->fp);
+#ifdef PLATFORM_WINDOWS
+    CloseHandle(f->handle);
+#else
+    close(f->fd);
+#endif
     free(f);
 }
 
+file_view file_map(const char *path) {
+    file_view view = malloc(sizeof(struct file_view));
+    *view = (struct file_view){.path = path};
+
+#ifdef PLATFORM_WINDOWS
+    view->file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+    if (view->file == INVALID_HANDLE_VALUE) {
+        log_error("Unable to open %s to map it.\n", path);
+        free(view);
+        return NULL;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(view->file, &size)) {
+        log_error("Unable to get the size of %s to map it.\n", path);
+        CloseHandle(view->file);
+        free(view);
+        return NULL;
+    }
+    view->size = (usize)size.QuadPart;
+
+    // Windows can't map an empty file, hand out an empty view instead.
+    if (view->size > 0) {
+        view->mapping = CreateFileMapping(view->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        view->data = view->mapping != NULL
+                         ? (const uint8 *)MapViewOfFile(view->mapping, FILE_MAP_READ, 0, 0, 0)
+                         : NULL;
+        if (view->data == NULL) {
+            log_error("Unable to map %s.\n", path);
+            if (view->mapping != NULL) {
+                CloseHandle(view->mapping);
+            }
+            CloseHandle(view->file);
+            free(view);
+            return NULL;
+        }
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        log_error("Unable to open %s to map it.\n", path);
+        free(view);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        log_error("Unable to get the size of %s to map it.\n", path);
+        close(fd);
+        free(view);
+        return NULL;
+    }
+    view->size = (usize)st.st_size;
+
+    // mmap() refuses a length of 0, an empty file gets an empty view instead.
+    if (view->size > 0) {
+        void *data = mmap(NULL, view->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            log_error("Unable to map %s.\n", path);
+            close(fd);
+            free(view);
+            return NULL;
+        }
+        view->data = (const uint8 *)data;
+    }
+    // The mapping keeps its own reference to the file.
+    close(fd);
+#endif
+
+    if (view->data == NULL) {
+        view->data = (const uint8 *)"";
+    }
+    return view;
+}
+
+const uint8 *file_view_data(file_view view) {
+    return view->data;
+}
+
+usize file_view_size(file_view view) {
+    return view->size;
+}
+
+void file_view_advise(file_view view, file_advice advice) {
+    if (view->size == 0) {
+        return;
+    }
+
+#ifdef PLATFORM_WINDOWS
+    // Windows only has a prefetch hint, the rest is up to its own read ahead.
+    if (advice == FILE_ADVICE_WILLNEED) {
+        WIN32_MEMORY_RANGE_ENTRY range = {(PVOID)view->data, view->size};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#else
+    int flags = MADV_NORMAL;
+    switch (advice) {
+    case FILE_ADVICE_SEQUENTIAL:
+        flags = MADV_SEQUENTIAL;
+        break;
+    case FILE_ADVICE_RANDOM:
+        flags = MADV_RANDOM;
+        break;
+    case FILE_ADVICE_WILLNEED:
+        flags = MADV_WILLNEED;
+        break;
+    default:
+        break;
+    }
+    madvise((void *)view->data, view->size, flags);
+#endif
+}
+
+void file_unmap(file_view view) {
+    if (view == NULL) {
+        return;
+    }
+
+#ifdef PLATFORM_WINDOWS
+    if (view->size > 0) {
+        UnmapViewOfFile(view->data);
+        CloseHandle(view->mapping);
+    }
+    CloseHandle(view->file);
+#else
+    if (view->size > 0) {
+        munmap((void *)view->data, view->size);
+    }
+#endif
+    free(view);
+}
+
 /*
 char* file_current_path(void) {
     //return SDL_GetBasePath();
@@ -33,12 +33,41 @@ typedef enum file_mode {
     FILE_MODE_READ_WRITE_BINARY,
 } file_mode;
 
+/* Reads and writes take an explicit offset and never move a shared cursor, so any number of
+    threads can read the same file object at once. */
 typedef struct file {
     const char *path;
-    uint32 size;
-    FILE *fp;
+    uint64 size;
+#ifdef PLATFORM_WINDOWS
+    HANDLE handle;
+#else
+    int fd;
+#endif
 } * file;
 
+typedef enum file_advice {
+    /* No particular access pattern, the OS decides how much to read ahead. */
+    FILE_ADVICE_NORMAL,
+    /* The view will be read front to back once, read ahead aggressively. */
+    FILE_ADVICE_SEQUENTIAL,
+    /* The view will be read in scattered pieces, don't bother reading ahead. */
+    FILE_ADVICE_RANDOM,
+    /* The whole view is about to be read, start paging it in now. */
+    FILE_ADVICE_WILLNEED,
+} file_advice;
+
+/* A read-only view of a whole file, mapped straight out of the page cache. Nothing is copied
+    and pages are only read in when they're first touched. */
+typedef struct file_view {
+    const char *path;
+    const uint8 *data;
+    usize size;
+#ifdef PLATFORM_WINDOWS
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} * file_view;
+
 /*
     Opens a file from the given path for read/write operations
         \param path The file path
@@ -52,7 +81,7 @@ file file_open(const char *path, file_mode mode);
         \param f The file object
         \return The file size
 */
-uint32 file_get_size(file f);
+uint64 file_get_size(file f);
 
 /*
     Gets the path from a file object
@@ -67,8 +96,9 @@ const char *file_get_path(file f);
         \param offset The offset in bytes to read from
         \param size The size in bytes to read
         \param data A preallocated pointer that the memory will be copied to
+        \return The number of bytes read, less than size if the file ended first
 */
-void file_read(file f, uint32 offset, uint32 size, void *data);
+uint64 file_read(file f, uint64 offset, uint64 size, void *data);
 
 /*
     Writes data to a file
@@ -76,8 +106,9 @@ void file_read(file f, uint32 offset, uint32 size, void *data);
         \param offset The offset in bytes to read at
         \param size The size in bytes to write
         \param data A pointer to the data to write
+        \return The number of bytes written
 */
-void file_write(file f, uint32 offset, uint32 size, void *data);
+uint64 file_write(file f, uint64 offset, uint64 size, void *data);
 
 /*
     Checks if a file exists
@@ -92,6 +123,40 @@ bool file_exists(const char *path);
 */
 void file_close(file f);
 
+/*
+    Maps a whole file read-only into memory
+        \param path The file path
+        \return The view, or NULL if the file can't be opened or mapped
+*/
+file_view file_map(const char *path);
+
+/*
+    Gets a pointer to the mapped bytes, valid until file_unmap(). The bytes aren't null terminated
+        \param view The view
+        \return The first byte of the file
+*/
+const uint8 *file_view_data(file_view view);
+
+/*
+    Gets the size of a mapped file
+        \param view The view
+        \return The file size in bytes
+*/
+usize file_view_size(file_view view);
+
+/*
+    Tells the OS how the view is about to be read so it can page it in accordingly
+        \param view The view
+        \param advice The expected access pattern
+*/
+void file_view_advise(file_view view, file_advice advice);
+
+/*
+    Unmaps the view. Pointers from file_view_data() are invalid afterwards. NULL is ignored
+        \param view The view to unmap
+*/
+void file_unmap(file_view view);
+
 /*
     Gets the current path that the process is running from.
         \return The path that it's running on
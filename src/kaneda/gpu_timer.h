@@ -0,0 +1,138 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include "core.h"
+#include "log.h"
+
+#include <string.h>
+
+/*
+ ██████╗ ██████╗ ██╗   ██╗    ████████╗██╗███╗   ███╗███████╗██████╗
+██╔════╝ ██╔══██╗██║   ██║    ╚══██╔══╝██║████╗ ████║██╔════╝██╔══██╗
+██║  ███╗██████╔╝██║   ██║       ██║   ██║██╔████╔██║█████╗  ██████╔╝
+██║   ██║██╔═══╝ ██║   ██║       ██║   ██║██║╚██╔╝██║██╔══╝  ██╔══██╗
+╚██████╔╝██║     ╚██████╔╝       ██║   ██║██║ ╚═╝ ██║███████╗██║  ██║
+ ╚═════╝ ╚═╝      ╚═════╝        ╚═╝   ╚═╝╚═╝     ╚═╝╚══════╝╚═╝  ╚═╝
+Each pass owns GPU_TIMER_LATENCY GL_TIME_ELAPSED queries and cycles through them one frame at a
+time. A query is only read back when its slot comes around again, by which point the GPU has long
+finished with it, so reading results never stalls the pipeline. Passes can't nest: GL only allows
+one GL_TIME_ELAPSED query to be active at once, so starting a pass ends the open one. The engine
+times draw() as "draw" and every render queue pass on its own, a pass the game starts inside
+draw() takes over from "draw" until it ends.
+*/
+
+void gpu_timer_init(GpuTimer *timer) {
+    *timer = (GpuTimer){0};
+    timer->active = -1;
+
+    // Timer queries are core since 3.3, which Mesa's llvmpipe and softpipe both expose.
+    timer->is_supported = GLAD_GL_VERSION_3_3 && glBeginQuery != NULL;
+    if (!timer->is_supported) {
+        log_warning("GPU timer queries are unavailable, GPU pass times will read 0.\n");
+    }
+}
+
+static int32 gpu_timer_find_pass(GpuTimer *timer, const char *name) {
+    for (uint32 i = 0; i < timer->pass_count; i++) {
+        if (timer->passes[i].name == name || strcmp(timer->passes[i].name, name) == 0) {
+            return (int32)i;
+        }
+    }
+
+    if (timer->pass_count >= GPU_TIMER_MAX_PASSES) {
+        log_warning("Too many GPU timer passes, ignoring \"%s\".\n", name);
+        return -1;
+    }
+
+    GpuPass *pass = &timer->passes[timer->pass_count];
+    *pass = (GpuPass){.name = name};
+    glGenQueries(GPU_TIMER_LATENCY, pass->queries);
+    return (int32)timer->pass_count++;
+}
+
+void gpu_timer_begin(GpuTimer *timer, const char *name) {
+    if (!timer->is_supported) {
+        return;
+    }
+    if (timer->active != -1) {
+        gpu_timer_end(timer);
+    }
+
+    int32 index = gpu_timer_find_pass(timer, name);
+    if (index == -1) {
+        return;
+    }
+
+    GpuPass *pass = &timer->passes[index];
+    uint32 slot = timer->frame % GPU_TIMER_LATENCY;
+    glBeginQuery(GL_TIME_ELAPSED, pass->queries[slot]);
+    pass->is_pending[slot] = true;
+    timer->active = index;
+}
+
+void gpu_timer_end(GpuTimer *timer) {
+    if (timer->active == -1) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    timer->active = -1;
+}
+
+// Call once per frame after the swap. Collects the oldest slot, which the next frame is about to
+// reuse, and sums the passes that resolved into `total`.
+void gpu_timer_frame(GpuTimer *timer) {
+    if (!timer->is_supported) {
+        return;
+    }
+    if (timer->active != -1) {
+        log_warning("GPU pass \"%s\" was never ended.\n", timer->passes[timer->active].name);
+        gpu_timer_end(timer);
+    }
+
+    timer->frame++;
+    uint32 slot = timer->frame % GPU_TIMER_LATENCY;
+
+    uint64 total = 0;
+    for (uint32 i = 0; i < timer->pass_count; i++) {
+        GpuPass *pass = &timer->passes[i];
+        if (!pass->is_pending[slot]) {
+            continue;
+        }
+
+        GLint available = 0;
+        glGetQueryObjectiv(pass->queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(pass->queries[slot], GL_QUERY_RESULT, &elapsed);
+            pass->elapsed = (uint64)elapsed;
+            pass->samples++;
+            total += pass->elapsed;
+        }
+        // If it still isn't ready we'd rather drop the sample than block on it, and leave it out
+        // of the total instead of counting an older frame's time again.
+        pass->is_pending[slot] = false;
+    }
+    timer->total = total;
+}
+
+// Last resolved GPU time of a pass in nanoseconds, 0 if it never ran.
+uint64 gpu_timer_get(GpuTimer *timer, const char *name) {
+    for (uint32 i = 0; i < timer->pass_count; i++) {
+        if (strcmp(timer->passes[i].name, name) == 0) {
+            return timer->passes[i].elapsed;
+        }
+    }
+    return 0;
+}
+
+void gpu_timer_destroy(GpuTimer *timer) {
+    if (timer->active != -1) {
+        gpu_timer_end(timer);
+    }
+    for (uint32 i = 0; i < timer->pass_count; i++) {
+        glDeleteQueries(GPU_TIMER_LATENCY, timer->passes[i].queries);
+    }
+    timer->pass_count = 0;
+}
+
+#endif
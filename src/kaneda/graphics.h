@@ -1,6 +1,71 @@
 #ifndef GRAPHICS_H
 #define GRAPHICS_H
 
+#if (defined PLATFORM_LINUX)
+#include <sys/inotify.h>
+#endif
+
+static void shader_watch_init(ShaderWatcher *watcher) {
+    *watcher = (ShaderWatcher){.fd = -1};
+#if (defined PLATFORM_LINUX)
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->fd < 0) {
+        log_warning("Unable to start watching shader sources, hot reload is off.\n");
+    }
+#else
+    log_warning("Shader hot reload needs inotify, it's off on this platform.\n");
+#endif
+}
+
+static void shader_watch_add(ShaderWatcher *watcher, const char *path) {
+    if (path == NULL || watcher->fd < 0) {
+        return;
+    }
+
+    char prefix[128];
+    const char *slash = strrchr(path, '/');
+    usize length = slash != NULL ? (usize)(slash - path) + 1 : 0;
+    if (length >= sizeof(prefix)) {
+        log_warning("Not watching %s, its directory name is too long.\n", path);
+        return;
+    }
+    memcpy(prefix, path, length);
+    prefix[length] = '\0';
+    for (uint32 i = 0; i < watcher->count; i++) {
+        if (strcmp(watcher->prefixes[i], prefix) == 0) {
+            return;
+        }
+    }
+    if (watcher->count == SHADER_WATCH_MAX_DIRS) {
+        log_warning("Not watching %s, already watching SHADER_WATCH_MAX_DIRS directories.\n", path);
+        return;
+    }
+
+#if (defined PLATFORM_LINUX)
+    // The prefix without its trailing slash, except for the root.
+    char directory[128];
+    snprintf(directory, sizeof(directory), "%.*s", length > 1 ? (int)length - 1 : 1,
+             length > 0 ? prefix : ".");
+    int watch = inotify_add_watch(watcher->fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch < 0) {
+        log_warning("Unable to watch %s for shader changes.\n", directory);
+        return;
+    }
+    watcher->watches[watcher->count] = watch;
+    memcpy(watcher->prefixes[watcher->count], prefix, length + 1);
+    watcher->count++;
+#endif
+}
+
+static void shader_watch_destroy(ShaderWatcher *watcher) {
+#if (defined PLATFORM_LINUX)
+    if (watcher->fd >= 0) {
+        close(watcher->fd);
+    }
+#endif
+    watcher->fd = -1;
+}
+
 Graphics *graphics_create() {
     Graphics *gfx = kamalloc_init(Graphics);
 
@@ -11,6 +76,22 @@ Graphics *graphics_create() {
     glViewport(0, 0, platform->window.render_size.width, platform->window.render_size.height);
 #endif
 
+    gpu_timer_init(&gfx->timer);
+    uniform_buffer_create(&gfx->uniforms, UNIFORM_BUFFER_SIZE);
+    gfx->watcher.fd = -1;
+    if (engine()->game.flags.use_hot_reload) {
+        shader_watch_init(&gfx->watcher);
+        shader_parallel_init();
+    }
+    gfx->queue.commands = malloc(sizeof(RenderCommand) * RENDER_QUEUE_SIZE);
+    gfx->queue.sorted = malloc(sizeof(RenderCommand) * RENDER_QUEUE_SIZE);
+    if (gfx->queue.commands == NULL || gfx->queue.sorted == NULL) {
+        log_fatal("Unable to allocate the render queue (%u draws).\n", RENDER_QUEUE_SIZE);
+    }
+    pool_create(&gfx->meshes, "meshes", sizeof(Mesh), MAX_MESHES);
+    pool_create(&gfx->textures, "textures", sizeof(Texture), MAX_TEXTURES);
+    pool_create(&gfx->shaders, "shaders", sizeof(Shader), MAX_SHADERS);
+
     return gfx;
 }
 
@@ -19,6 +100,26 @@ void graphics_destroy(Graphics *graphics) {
         return;
     }
 
+    gpu_timer_destroy(&graphics->timer);
+    uniform_buffer_destroy(&graphics->uniforms);
+    shader_watch_destroy(&graphics->watcher);
+    free(graphics->queue.commands);
+    free(graphics->queue.sorted);
+
+    // Anything the game didn't destroy itself still owns GL objects.
+    for (uint32 i = 0; i < graphics->meshes.count; i++) {
+        mesh_release((Mesh *)pool_at(&graphics->meshes, i));
+    }
+    for (uint32 i = 0; i < graphics->textures.count; i++) {
+        glDeleteTextures(1, &((Texture *)pool_at(&graphics->textures, i))->id);
+    }
+    for (uint32 i = 0; i < graphics->shaders.count; i++) {
+        shader_destroy((Shader *)pool_at(&graphics->shaders, i));
+    }
+    pool_destroy(&graphics->meshes);
+    pool_destroy(&graphics->textures);
+    pool_destroy(&graphics->shaders);
+
     // free pipeline data
 
     // free render pass data
@@ -29,4 +130,556 @@ void graphics_destroy(Graphics *graphics) {
     graphics = NULL;
 }
 
+static void shader_watch_sources(ShaderWatcher *watcher, Shader *shader) {
+    const char *source = shader->sources;
+    for (uint32 i = 0; i < shader->source_count; i++, source += strlen(source) + 1) {
+        shader_watch_add(watcher, source);
+    }
+}
+
+// Compiles and links a program into the shader pool, geom_path and defines can be NULL. Loading
+// a permutation that's already loaded hands back the same program, every load needs an unload.
+// Returns a null handle if it doesn't build.
+ShaderHandle shader_load(const char *vert_path, const char *frag_path, const char *geom_path,
+                         const char *defines) {
+    Pool *shaders = &engine()->graphics->shaders;
+    uint64 permutation = shader_permutation_key(vert_path, frag_path, geom_path, defines);
+    for (uint32 i = 0; i < shaders->count; i++) {
+        Shader *shader = (Shader *)pool_at(shaders, i);
+        if (shader->permutation == permutation) {
+            shader->references++;
+            return (ShaderHandle){pool_handle_at(shaders, i)};
+        }
+    }
+
+    ShaderHandle handle = {pool_alloc(shaders)};
+    Shader *shader = shader_get(handle);
+    if (shader != NULL && !shader_create(shader, vert_path, frag_path, geom_path, defines)) {
+        pool_free(shaders, handle.id);
+        handle.id = POOL_HANDLE_NULL;
+        return handle;
+    }
+    if (shader != NULL) {
+        shader->references = 1;
+        shader_watch_sources(&engine()->graphics->watcher, shader);
+    }
+    return handle;
+}
+
+Shader *shader_get(ShaderHandle handle) {
+    return (Shader *)pool_get(&engine()->graphics->shaders, handle.id);
+}
+
+void shader_unload(ShaderHandle handle) {
+    Shader *shader = shader_get(handle);
+    if (shader == NULL || --shader->references > 0) {
+        return;
+    }
+    shader_destroy(shader);
+    pool_free(&engine()->graphics->shaders, handle.id);
+}
+
+bool uniform_buffer_create(UniformBuffer *buffer, usize size) {
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    *buffer = (UniformBuffer){.alignment = alignment > 0 ? (usize)alignment : 256};
+    buffer->size = (size + buffer->alignment - 1) / buffer->alignment * buffer->alignment;
+
+    glGenBuffers(1, &buffer->buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer->buffer);
+    glBufferData(GL_UNIFORM_BUFFER, buffer->size * UNIFORM_BUFFER_FRAMES, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    if (buffer->buffer == 0) {
+        log_error("Unable to create a %zu byte uniform buffer.\n", buffer->size);
+        return false;
+    }
+    return true;
+}
+
+void uniform_buffer_destroy(UniformBuffer *buffer) {
+    uniform_buffer_end(buffer);
+    for (uint32 i = 0; i < UNIFORM_BUFFER_FRAMES; i++) {
+        if (buffer->fences[i] != NULL) {
+            glDeleteSync(buffer->fences[i]);
+        }
+    }
+    glDeleteBuffers(1, &buffer->buffer);
+    *buffer = (UniformBuffer){0};
+}
+
+// Maps the next region for writing. Everything drawn from the last one has been issued by now, so
+// that's where its fence goes.
+bool uniform_buffer_begin(UniformBuffer *buffer) {
+    if (buffer->mapped != NULL) {
+        return true;
+    }
+    if (buffer->used > 0) {
+        buffer->fences[buffer->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    buffer->region = (buffer->region + 1) % UNIFORM_BUFFER_FRAMES;
+    buffer->used = 0;
+
+    GLsync fence = buffer->fences[buffer->region];
+    if (fence != NULL) {
+        PROFILE_BEGIN("uniform buffer wait");
+        if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) ==
+            GL_TIMEOUT_EXPIRED) {
+            log_warning("GPU still reading uniforms from %u frames ago, overwriting them.\n",
+                        UNIFORM_BUFFER_FRAMES);
+        }
+        PROFILE_END();
+        glDeleteSync(fence);
+        buffer->fences[buffer->region] = NULL;
+    }
+
+    // Unsynchronized, the fence above already did the waiting GL would do.
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer->buffer);
+    buffer->mapped = glMapBufferRange(
+        GL_UNIFORM_BUFFER, buffer->region * buffer->size, buffer->size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    if (buffer->mapped == NULL) {
+        log_error("Unable to map uniform buffer region %u.\n", buffer->region);
+        return false;
+    }
+    return true;
+}
+
+// Copies a block into the mapped region and returns its offset for uniform_buffer_bind(), or
+// UNIFORM_BUFFER_FULL if the region is out of room or isn't mapped.
+usize uniform_buffer_push(UniformBuffer *buffer, const void *data, usize size) {
+    usize start = (buffer->used + buffer->alignment - 1) / buffer->alignment * buffer->alignment;
+    if (buffer->mapped == NULL || start + size > buffer->size) {
+        return UNIFORM_BUFFER_FULL;
+    }
+    memcpy(buffer->mapped + start, data, size);
+    buffer->used = start + size;
+    return buffer->region * buffer->size + start;
+}
+
+// Has to be called before anything is drawn with the blocks pushed since begin.
+void uniform_buffer_end(UniformBuffer *buffer) {
+    if (buffer->mapped == NULL) {
+        return;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer->buffer);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    buffer->mapped = NULL;
+}
+
+void uniform_buffer_bind(UniformBuffer *buffer, GLuint binding, usize offset, usize size) {
+    if (offset == UNIFORM_BUFFER_FULL) {
+        return;
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer->buffer, (GLintptr)offset,
+                      (GLsizeiptr)size);
+}
+
+// A frame writes its blocks between graphics_uniforms_begin() and graphics_uniforms_end(), then
+// draws with them:
+//
+//     graphics_uniforms_begin();
+//     graphics_set_frame(&frame);
+//     usize crate = graphics_push_object(&crate_uniforms);
+//     graphics_uniforms_end();
+//     graphics_bind_object(crate);
+//     mesh_draw(crate_mesh, shader);
+void graphics_uniforms_begin(void) {
+    if (engine()->graphics == NULL) {
+        return;
+    }
+    uniform_buffer_begin(&engine()->graphics->uniforms);
+}
+
+void graphics_uniforms_end(void) {
+    if (engine()->graphics == NULL) {
+        return;
+    }
+    uniform_buffer_end(&engine()->graphics->uniforms);
+}
+
+// Writes the Frame block and binds it for every program, it stays bound for the whole frame.
+void graphics_set_frame(const FrameUniforms *frame) {
+    if (engine()->graphics == NULL) {
+        return;
+    }
+    UniformBuffer *uniforms = &engine()->graphics->uniforms;
+    usize offset = uniform_buffer_push(uniforms, frame, sizeof(FrameUniforms));
+    if (offset == UNIFORM_BUFFER_FULL) {
+        log_error("No room for the Frame uniforms, raise UNIFORM_BUFFER_SIZE.\n");
+        return;
+    }
+    uniform_buffer_bind(uniforms, SHADER_BLOCK_FRAME, offset, sizeof(FrameUniforms));
+}
+
+usize graphics_push_object(const ObjectUniforms *object) {
+    if (engine()->graphics == NULL) {
+        return UNIFORM_BUFFER_FULL;
+    }
+    usize offset = uniform_buffer_push(&engine()->graphics->uniforms, object, sizeof(*object));
+    if (offset == UNIFORM_BUFFER_FULL) {
+        log_error("No room for more Object uniforms, raise UNIFORM_BUFFER_SIZE.\n");
+    }
+    return offset;
+}
+
+void graphics_bind_object(usize offset) {
+    if (engine()->graphics == NULL) {
+        return;
+    }
+    uniform_buffer_bind(&engine()->graphics->uniforms, SHADER_BLOCK_OBJECT, offset,
+                        sizeof(ObjectUniforms));
+}
+
+// RENDER QUEUE ----------------------------
+// Draws are queued with a 64 bit key and replayed in key order once draw() returns, so the draws
+// that share a program, textures or mesh end up next to each other and replay only touches GL
+// state that actually changes. From the top bit down:
+//
+//     | pass 4 | shader 8 | texture 12 | mesh 12 | depth 28 |
+//
+// texture is the mesh's first one, which is what tells one material from another here. depth is
+// front to back, so opaque draws reject what's behind them early. Passes marked back to front
+// move an inverted depth up under the pass instead, translucent draws blend in the right order
+// at the cost of more state changes. Pool indices that don't fit their bits only sort worse,
+// replay compares the real objects.
+
+#define RENDER_KEY_PASS_BITS 4
+#define RENDER_KEY_SHADER_BITS 8
+#define RENDER_KEY_TEXTURE_BITS 12
+#define RENDER_KEY_MESH_BITS 12
+#define RENDER_KEY_DEPTH_BITS 28
+#define RENDER_MAX_TEXTURE_UNITS 16
+
+// GPU timer names of the queue passes, the timer keeps the pointers.
+static const char *render_pass_names[1u << RENDER_KEY_PASS_BITS] = {
+    "render pass 0",  "render pass 1",  "render pass 2",  "render pass 3",
+    "render pass 4",  "render pass 5",  "render pass 6",  "render pass 7",
+    "render pass 8",  "render pass 9",  "render pass 10", "render pass 11",
+    "render pass 12", "render pass 13", "render pass 14", "render pass 15"};
+
+static inline uint64 render_key_bits(uint64 value, uint32 bits) {
+    return value & ((1ull << bits) - 1);
+}
+
+static uint64 render_key(uint32 pass, uint32 shader, uint32 texture, uint32 mesh, float32 depth,
+                         bool is_back_to_front) {
+    // NaN fails every comparison, it lands on 0 instead of reaching the cast. Scaled in float64,
+    // 2^28 - 1 doesn't survive the trip through a float32 and 1.0 would spill into the mesh bits.
+    float64 clamped = depth > 0.0f ? (depth < 1.0f ? (float64)depth : 1.0) : 0.0;
+    uint64 depth_max = (1ull << RENDER_KEY_DEPTH_BITS) - 1;
+    uint64 depth_bits = (uint64)(clamped * (float64)depth_max);
+    depth_bits = render_key_bits(depth_bits < depth_max ? depth_bits : depth_max,
+                                 RENDER_KEY_DEPTH_BITS);
+    uint64 state = render_key_bits(shader, RENDER_KEY_SHADER_BITS);
+    state = (state << RENDER_KEY_TEXTURE_BITS) | render_key_bits(texture, RENDER_KEY_TEXTURE_BITS);
+    state = (state << RENDER_KEY_MESH_BITS) | render_key_bits(mesh, RENDER_KEY_MESH_BITS);
+
+    uint64 key = render_key_bits(pass, RENDER_KEY_PASS_BITS);
+    if (is_back_to_front) {
+        depth_bits = render_key_bits(~depth_bits, RENDER_KEY_DEPTH_BITS);
+        key = (key << RENDER_KEY_DEPTH_BITS) | depth_bits;
+        return (key << (64 - RENDER_KEY_PASS_BITS - RENDER_KEY_DEPTH_BITS)) | state;
+    }
+    key = (key << (64 - RENDER_KEY_PASS_BITS - RENDER_KEY_DEPTH_BITS)) | state;
+    return (key << RENDER_KEY_DEPTH_BITS) | depth_bits;
+}
+
+// Queues a draw of mesh with shader and the Object block at object, which has to have been pushed
+// this frame. pass orders groups of draws (0 first) and depth, 0 near to 1 far, orders draws in a
+// pass. Cheap enough to call for everything, nothing touches GL until graphics_render().
+void graphics_draw(uint32 pass, MeshHandle mesh, ShaderHandle shader, usize object,
+                   float32 depth) {
+    if (engine()->graphics == NULL) {
+        return;
+    }
+    RenderQueue *queue = &engine()->graphics->queue;
+    if (queue->count == RENDER_QUEUE_SIZE) {
+        if (!queue->is_full) {
+            log_error("Render queue is full, dropping draws. Raise RENDER_QUEUE_SIZE.\n");
+            queue->is_full = true;
+        }
+        return;
+    }
+    if (pass >= (1u << RENDER_KEY_PASS_BITS)) {
+        log_error("Render pass %u is out of range, there are %u.\n", pass,
+                  1u << RENDER_KEY_PASS_BITS);
+        return;
+    }
+
+    Mesh *drawn = mesh_get(mesh);
+    uint32 texture = 0;
+    if (drawn != NULL && sb_count(drawn->textures) > 0) {
+        texture = pool_handle_index(drawn->textures[0].id);
+    }
+    bool is_back_to_front = (queue->back_to_front >> pass) & 1;
+    queue->commands[queue->count++] = (RenderCommand){
+        .key = render_key(pass, pool_handle_index(shader.id), texture,
+                          pool_handle_index(mesh.id), depth, is_back_to_front),
+        .mesh = mesh,
+        .shader = shader,
+        .object = object,
+    };
+}
+
+void graphics_pass_back_to_front(uint32 pass, bool is_back_to_front) {
+    if (engine()->graphics == NULL || pass >= (1u << RENDER_KEY_PASS_BITS)) {
+        return;
+    }
+    RenderQueue *queue = &engine()->graphics->queue;
+    if (is_back_to_front) {
+        queue->back_to_front |= (uint16)(1u << pass);
+    } else {
+        queue->back_to_front &= (uint16)~(1u << pass);
+    }
+}
+
+// Least significant byte first. All eight histograms come out of one read of the keys, and a byte
+// every key shares can't reorder anything so its pass is skipped, most frames only use a few.
+static void render_queue_sort(RenderQueue *queue) {
+    uint32 counts[8][256] = {{0}};
+    for (uint32 i = 0; i < queue->count; i++) {
+        uint64 key = queue->commands[i].key;
+        for (uint32 byte = 0; byte < 8; byte++) {
+            counts[byte][(key >> (byte * 8)) & 0xFF]++;
+        }
+    }
+
+    RenderCommand *from = queue->commands;
+    RenderCommand *to = queue->sorted;
+    for (uint32 byte = 0; byte < 8; byte++) {
+        uint32 shift = byte * 8;
+        if (counts[byte][(from[0].key >> shift) & 0xFF] == queue->count) {
+            continue;
+        }
+
+        uint32 offset = 0;
+        for (uint32 digit = 0; digit < 256; digit++) {
+            uint32 count = counts[byte][digit];
+            counts[byte][digit] = offset;
+            offset += count;
+        }
+        for (uint32 i = 0; i < queue->count; i++) {
+            to[counts[byte][(from[i].key >> shift) & 0xFF]++] = from[i];
+        }
+        RenderCommand *swap = from;
+        from = to;
+        to = swap;
+    }
+    queue->commands = from;
+    queue->sorted = to;
+}
+
+// What replay last set, so only changes reach GL. Reset every graphics_render(), anything may
+// have touched GL between them.
+typedef struct RenderState {
+    Shader *shader;
+    GLuint vao;
+    usize object;
+    uint32 active_unit;
+    GLuint textures[RENDER_MAX_TEXTURE_UNITS];
+    // The sampler uniform each unit is known to feed in the current program, type and number.
+    const char *sampler_types[RENDER_MAX_TEXTURE_UNITS];
+    uint32 sampler_numbers[RENDER_MAX_TEXTURE_UNITS];
+    uint32 changes;
+} RenderState;
+
+static bool render_state_sampler_is(RenderState *state, uint32 unit, const char *type,
+                                    uint32 number) {
+    return state->sampler_types[unit] != NULL && state->sampler_numbers[unit] == number &&
+           strcmp(state->sampler_types[unit], type) == 0;
+}
+
+// Same sampler naming as mesh_draw(): material.texture_diffuse1, material.texture_specular1...
+static void render_state_textures(RenderState *state, Mesh *mesh) {
+    uint32 diffuse_number = 1, specular_number = 1;
+    uint32 count = (uint32)sb_count(mesh->textures);
+    if (count > RENDER_MAX_TEXTURE_UNITS) {
+        count = RENDER_MAX_TEXTURE_UNITS;
+    }
+    for (uint32 i = 0; i < count; i++) {
+        Texture *texture = texture_get(mesh->textures[i]);
+        if (texture == NULL) {
+            continue;
+        }
+
+        uint32 number = 0;
+        if (strcmp(texture->type, "texture_diffuse") == 0) {
+            number = diffuse_number++;
+        } else if (strcmp(texture->type, "texture_specular") == 0) {
+            number = specular_number++;
+        }
+        // Samplers are program state, they only need setting for a new program or when a unit
+        // holds a different kind of texture than the last mesh had there.
+        if (!render_state_sampler_is(state, i, texture->type, number)) {
+            char uniform[64];
+            snprintf(uniform, sizeof(uniform), "material.%s%u", texture->type, number);
+            shader_set_int(state->shader, uniform, (int)i);
+            // The sampler no longer reads whichever unit it read before.
+            for (uint32 unit = 0; unit < RENDER_MAX_TEXTURE_UNITS; unit++) {
+                if (render_state_sampler_is(state, unit, texture->type, number)) {
+                    state->sampler_types[unit] = NULL;
+                }
+            }
+            state->sampler_types[i] = texture->type;
+            state->sampler_numbers[i] = number;
+            state->changes++;
+        }
+        if (state->textures[i] != texture->id) {
+            if (state->active_unit != i) {
+                glActiveTexture(GL_TEXTURE0 + i);
+                state->active_unit = i;
+            }
+            glBindTexture(GL_TEXTURE_2D, texture->id);
+            state->textures[i] = texture->id;
+            state->changes++;
+        }
+    }
+}
+
+// Sorts what graphics_draw() queued and draws it, then empties the queue. The engine calls it
+// once draw() returns, call it earlier to get queued draws in before something drawn directly.
+void graphics_render(void) {
+    Graphics *graphics = engine()->graphics;
+    if (graphics == NULL) {
+        return;
+    }
+    // Commands point into this frame's uniform region, it can't be mapped while they draw.
+    graphics_uniforms_end();
+    RenderQueue *queue = &graphics->queue;
+    if (queue->count == 0) {
+        return;
+    }
+    PROFILE_BEGIN("render queue");
+
+    render_queue_sort(queue);
+    RenderState state = {.object = UNIFORM_BUFFER_FULL};
+    uint32 draws = 0;
+    uint32 pass = UINT32_MAX;
+    for (uint32 i = 0; i < queue->count; i++) {
+        RenderCommand *command = &queue->commands[i];
+        uint32 command_pass = (uint32)(command->key >> (64 - RENDER_KEY_PASS_BITS));
+        if (command_pass != pass) {
+            graphics_pass_begin(render_pass_names[command_pass]);
+            pass = command_pass;
+        }
+        Mesh *mesh = mesh_get(command->mesh);
+        Shader *shader = shader_get(command->shader);
+        if (mesh == NULL || shader == NULL || command->object == UNIFORM_BUFFER_FULL) {
+            continue;
+        }
+
+        if (shader != state.shader) {
+            shader_use(shader);
+            state.shader = shader;
+            memset(state.sampler_types, 0, sizeof(state.sampler_types));
+            state.changes++;
+        }
+        render_state_textures(&state, mesh);
+        if (command->object != state.object) {
+            graphics_bind_object(command->object);
+            state.object = command->object;
+        }
+        if (mesh->vao != state.vao) {
+            glBindVertexArray(mesh->vao);
+            state.vao = mesh->vao;
+            state.changes++;
+        }
+        glDrawElements(GL_TRIANGLES, sb_count(mesh->indices), GL_UNSIGNED_INT, 0);
+        draws++;
+    }
+    graphics_pass_end();
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+
+    PROFILE_COUNTER("render.draws", (float64)draws);
+    PROFILE_COUNTER("render.state_changes", (float64)state.changes);
+    queue->count = 0;
+    queue->is_full = false;
+    PROFILE_END();
+}
+// -----------------------------------------
+
+// Runs between frames: starts rebuilding the programs whose sources were saved since the last
+// frame and swaps in the ones that finished. Nothing is ever waited on here unless the driver
+// lacks parallel shader compile.
+void graphics_hot_reload(void) {
+    Graphics *graphics = engine()->graphics;
+    if (graphics == NULL || graphics->watcher.fd < 0) {
+        return;
+    }
+    PROFILE_BEGIN("hot reload");
+
+#if (defined PLATFORM_LINUX)
+    ShaderWatcher *watcher = &graphics->watcher;
+    uint8 buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t size;
+    while ((size = read(watcher->fd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t at = 0; at < size;) {
+            struct inotify_event *event = (struct inotify_event *)(buffer + at);
+            at += sizeof(struct inotify_event) + event->len;
+            if (event->len == 0) {
+                continue;
+            }
+
+            const char *prefix = NULL;
+            for (uint32 i = 0; i < watcher->count; i++) {
+                if (watcher->watches[i] == event->wd) {
+                    prefix = watcher->prefixes[i];
+                }
+            }
+            if (prefix == NULL) {
+                continue;
+            }
+            char path[256];
+            snprintf(path, sizeof(path), "%s%s", prefix, event->name);
+
+            for (uint32 i = 0; i < graphics->shaders.count; i++) {
+                Shader *shader = (Shader *)pool_at(&graphics->shaders, i);
+                if (shader_uses_path(shader, path)) {
+                    log_info("%s changed, rebuilding program %s.\n", path, shader->paths[0]);
+                    // It may #include something new now.
+                    if (shader_reload_begin(shader)) {
+                        shader_watch_sources(watcher, shader);
+                    }
+                }
+            }
+        }
+    }
+#endif
+
+    for (uint32 i = 0; i < graphics->shaders.count; i++) {
+        Shader *shader = (Shader *)pool_at(&graphics->shaders, i);
+        if (shader->reload.program_id != 0) {
+            shader_reload_poll(shader);
+        }
+    }
+    PROFILE_END();
+}
+
+// Brackets a render pass with a GPU timer query. Passes run back to back, starting one ends the
+// pass that's open.
+void graphics_pass_begin(const char *name) {
+    if (engine()->graphics == NULL) {
+        return;
+    }
+    gpu_timer_begin(&engine()->graphics->timer, name);
+}
+
+void graphics_pass_end(void) {
+    if (engine()->graphics == NULL) {
+        return;
+    }
+    gpu_timer_end(&engine()->graphics->timer);
+}
+
+// GPU time of the named pass in nanoseconds, from GPU_TIMER_LATENCY - 1 frames ago.
+uint64 graphics_pass_time(const char *name) {
+    if (engine()->graphics == NULL) {
+        return 0;
+    }
+    return gpu_timer_get(&engine()->graphics->timer, name);
+}
+
 #endif
\ No newline at end of file
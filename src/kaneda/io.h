@@ -0,0 +1,464 @@
+#ifndef IO_H
+#define IO_H
+
+#include "core.h"
+#include "file.h"
+#include "log.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+#include <fcntl.h>
+#endif
+
+#if (defined PLATFORM_LINUX && !defined NO_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define IO_URING
+#endif
+
+/*
+██╗ ██████╗
+██║██╔═══██╗
+██║██║   ██║
+██║██║   ██║
+██║╚██████╔╝
+╚═╝ ╚═════╝
+File reads that don't stall the frame. io_read() hands a request to the queue and returns right
+away, io_poll() checks on it and io_wait() blocks until it's done. On Linux the reads go to the
+kernel through io_uring and one thread reaps the completions, anywhere else (or on kernels older
+than 5.6) IO_WORKER_COUNT threads do plain blocking reads. Either way a short read is continued
+until the request is filled or the file ends, so a done request is only short at end of file.
+
+Requests by path open the file on the submitting thread with io_uring, on a worker otherwise.
+Windows has no workers yet, io_read() does the read itself and is done when it returns.
+*/
+
+// Same as io_finish() for callers that already hold the lock.
+static void io_finish_locked(IoQueue *io, IoRequest *request, IoStatus status, int32 error) {
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+    if (request->is_owned) {
+        close(request->fd);
+    }
+#endif
+    request->error = error;
+    __atomic_store_n(&request->status, status, __ATOMIC_RELEASE);
+    io->in_flight--;
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+    pthread_cond_broadcast(&io->done);
+#endif
+}
+
+static void io_finish(IoQueue *io, IoRequest *request, IoStatus status, int32 error) {
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+    pthread_mutex_lock(&io->lock);
+    io_finish_locked(io, request, status, error);
+    pthread_mutex_unlock(&io->lock);
+#else
+    io_finish_locked(io, request, status, error);
+#endif
+}
+
+#ifdef IO_URING
+static int io_uring_setup(uint32 entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int ring, uint32 to_submit, uint32 min_complete, uint32 flags) {
+    return (int)syscall(__NR_io_uring_enter, ring, to_submit, min_complete, flags, NULL, 0);
+}
+
+static bool io_uring_create(IoQueue *io) {
+    struct io_uring_params params = {0};
+    io->ring = io_uring_setup(IO_QUEUE_SIZE, &params);
+    if (io->ring < 0) {
+        return false;
+    }
+    // IORING_OP_READ came in 5.6, same as this feature bit, and there's no cheaper way to ask.
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        close(io->ring);
+        return false;
+    }
+
+    io->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32);
+    io->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (io->cq_ring_size > io->sq_ring_size) {
+            io->sq_ring_size = io->cq_ring_size;
+        }
+        io->cq_ring_size = io->sq_ring_size;
+    }
+    io->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    io->sq_ring = mmap(NULL, io->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       io->ring, IORING_OFF_SQ_RING);
+    io->cq_ring = io->sq_ring;
+    if (io->sq_ring != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        io->cq_ring = mmap(NULL, io->cq_ring_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, io->ring, IORING_OFF_CQ_RING);
+    }
+    io->sqes = mmap(NULL, io->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    io->ring, IORING_OFF_SQES);
+    if (io->sq_ring == MAP_FAILED || io->cq_ring == MAP_FAILED || io->sqes == MAP_FAILED) {
+        log_warning("Unable to map the io_uring rings.\n");
+        if (io->sqes != MAP_FAILED) {
+            munmap(io->sqes, io->sqes_size);
+        }
+        if (io->cq_ring != MAP_FAILED && io->cq_ring != io->sq_ring) {
+            munmap(io->cq_ring, io->cq_ring_size);
+        }
+        if (io->sq_ring != MAP_FAILED) {
+            munmap(io->sq_ring, io->sq_ring_size);
+        }
+        close(io->ring);
+        return false;
+    }
+
+    uint8 *sq = (uint8 *)io->sq_ring;
+    uint8 *cq = (uint8 *)io->cq_ring;
+    io->sq_head = (uint32 *)(sq + params.sq_off.head);
+    io->sq_tail = (uint32 *)(sq + params.sq_off.tail);
+    io->sq_mask = (uint32 *)(sq + params.sq_off.ring_mask);
+    io->sq_array = (uint32 *)(sq + params.sq_off.array);
+    io->cq_head = (uint32 *)(cq + params.cq_off.head);
+    io->cq_tail = (uint32 *)(cq + params.cq_off.tail);
+    io->cq_mask = (uint32 *)(cq + params.cq_off.ring_mask);
+    io->cqes = cq + params.cq_off.cqes;
+    return true;
+}
+
+static void io_uring_destroy(IoQueue *io) {
+    munmap(io->sqes, io->sqes_size);
+    if (io->cq_ring != io->sq_ring) {
+        munmap(io->cq_ring, io->cq_ring_size);
+    }
+    munmap(io->sq_ring, io->sq_ring_size);
+    close(io->ring);
+}
+
+// Call with the lock held, it's the only thing keeping the submission ring single producer.
+static void io_uring_push(IoQueue *io, uint8 opcode, IoRequest *request) {
+    uint32 tail = *io->sq_tail;
+    uint32 index = tail & *io->sq_mask;
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe *)io->sqes)[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = -1;
+    sqe->user_data = (uint64)(uintptr_t)request;
+    if (request != NULL) {
+        // A single read tops out at 2GB anyway, what's left is continued when this one lands.
+        uint64 left = request->size - request->bytes;
+        sqe->fd = request->fd;
+        sqe->off = request->offset + request->bytes;
+        sqe->addr = (uint64)(uintptr_t)((uint8 *)request->data + request->bytes);
+        sqe->len = left > 0x40000000 ? 0x40000000 : (uint32)left;
+    }
+    io->sq_array[index] = index;
+    __atomic_store_n(io->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    // Everything the kernel hasn't taken yet, in case an earlier enter gave up part way.
+    uint32 unsubmitted = tail + 1 - __atomic_load_n(io->sq_head, __ATOMIC_ACQUIRE);
+    int result;
+    do {
+        result = io_uring_enter(io->ring, unsubmitted, 0, 0);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+        int32 error = errno;
+        log_error("io_uring_enter couldn't submit %u reads: %s.\n", unsubmitted,
+                  strerror(error));
+
+        // The kernel took none of them, so take them back and fail them rather than leave them
+        // pending forever. Nothing else submits, the head can't move under us.
+        uint32 head = __atomic_load_n(io->sq_head, __ATOMIC_ACQUIRE);
+        for (uint32 i = head; i != tail + 1; i++) {
+            struct io_uring_sqe *failed =
+                &((struct io_uring_sqe *)io->sqes)[io->sq_array[i & *io->sq_mask]];
+            IoRequest *taken = (IoRequest *)(uintptr_t)failed->user_data;
+            if (taken != NULL) {
+                io_finish_locked(io, taken, IO_FAILED, error);
+            }
+        }
+        __atomic_store_n(io->sq_tail, head, __ATOMIC_RELEASE);
+    }
+}
+
+static void io_uring_complete(IoQueue *io, IoRequest *request, int32 result) {
+    if (result == -EINTR || result == -EAGAIN) {
+        pthread_mutex_lock(&io->lock);
+        io_uring_push(io, IORING_OP_READ, request);
+        pthread_mutex_unlock(&io->lock);
+        return;
+    }
+    if (result < 0) {
+        io_finish(io, request, IO_FAILED, -result);
+        return;
+    }
+
+    request->bytes += (uint64)result;
+    if (result > 0 && request->bytes < request->size) {
+        pthread_mutex_lock(&io->lock);
+        io_uring_push(io, IORING_OP_READ, request);
+        pthread_mutex_unlock(&io->lock);
+        return;
+    }
+    io_finish(io, request, IO_DONE, 0);
+}
+
+// Sleeps in the kernel until reads complete. io_destroy() wakes it with a NOP carrying no request.
+static void *io_uring_reaper(void *arg) {
+    IoQueue *io = (IoQueue *)arg;
+    bool is_running = true;
+
+    while (is_running) {
+        int result = io_uring_enter(io->ring, 0, 1, IORING_ENTER_GETEVENTS);
+        if (result < 0 && errno != EINTR) {
+            log_error("io_uring_enter couldn't wait for completions: %s.\n", strerror(errno));
+        }
+
+        uint32 head = *io->cq_head;
+        uint32 tail = __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe cqe = ((struct io_uring_cqe *)io->cqes)[head & *io->cq_mask];
+            // Hand the slot back before handling it, a continued read may need the room.
+            __atomic_store_n(io->cq_head, ++head, __ATOMIC_RELEASE);
+
+            IoRequest *request = (IoRequest *)(uintptr_t)cqe.user_data;
+            if (request == NULL) {
+                is_running = false;
+                continue;
+            }
+            io_uring_complete(io, request, cqe.res);
+        }
+    }
+    return NULL;
+}
+#endif
+
+// Blocking read for the worker threads, keeps going through short reads until the file ends.
+static void io_read_blocking(IoQueue *io, IoRequest *request) {
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+    if (request->file == NULL) {
+        request->fd = open(request->path, O_RDONLY | O_CLOEXEC);
+        if (request->fd < 0) {
+            io_finish(io, request, IO_FAILED, errno);
+            return;
+        }
+        request->is_owned = true;
+    }
+
+    while (request->bytes < request->size) {
+        ssize_t count = pread(request->fd, (uint8 *)request->data + request->bytes,
+                              (usize)(request->size - request->bytes),
+                              (off_t)(request->offset + request->bytes));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            io_finish(io, request, IO_FAILED, errno);
+            return;
+        }
+        if (count == 0) {
+            break;
+        }
+        request->bytes += (uint64)count;
+    }
+#else
+    file f = request->file;
+    if (f == NULL) {
+        if (!file_exists(request->path)) {
+            io_finish(io, request, IO_FAILED, ENOENT);
+            return;
+        }
+        f = file_open(request->path, FILE_MODE_READ_BINARY);
+    }
+    request->bytes = request->offset < f->size
+                         ? file_read(f, request->offset, request->size, request->data)
+                         : 0;
+    if (f != request->file) {
+        file_close(f);
+    }
+#endif
+    io_finish(io, request, IO_DONE, 0);
+}
+
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+static void *io_worker(void *arg) {
+    IoQueue *io = (IoQueue *)arg;
+
+    pthread_mutex_lock(&io->lock);
+    while (true) {
+        while (io->head == io->tail && io->is_running) {
+            pthread_cond_wait(&io->work, &io->lock);
+        }
+        if (io->head == io->tail) {
+            break;
+        }
+        IoRequest *request = io->pending[io->head++ & (IO_QUEUE_SIZE - 1)];
+        pthread_mutex_unlock(&io->lock);
+
+        PROFILE_BEGIN("io read");
+        io_read_blocking(io, request);
+        PROFILE_END();
+
+        pthread_mutex_lock(&io->lock);
+    }
+    pthread_mutex_unlock(&io->lock);
+    return NULL;
+}
+#endif
+
+IoQueue *io_create(void) {
+    IoQueue *io = kamalloc_init(IoQueue);
+    io->is_running = true;
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+    pthread_mutex_init(&io->lock, NULL);
+    pthread_cond_init(&io->done, NULL);
+    pthread_cond_init(&io->work, NULL);
+
+#ifdef IO_URING
+    if (io_uring_create(io)) {
+        if (pthread_create(&io->threads[0], NULL, io_uring_reaper, io) == 0) {
+            io->is_uring = true;
+            io->thread_count = 1;
+            log_info("IO: io_uring, %u reads in flight.\n", IO_QUEUE_SIZE);
+            return io;
+        }
+        io_uring_destroy(io);
+    }
+#endif
+
+    for (uint32 i = 0; i < IO_WORKER_COUNT; i++) {
+        if (pthread_create(&io->threads[i], NULL, io_worker, io) != 0) {
+            log_warning("Unable to start I/O worker %u, continuing with %u.\n", i, i);
+            break;
+        }
+        io->thread_count++;
+    }
+#endif
+    if (io->thread_count == 0) {
+        log_warning("No I/O workers, reads will block the thread that asks for them.\n");
+    }
+    log_info("IO: %u workers, %u reads in flight.\n", io->thread_count, IO_QUEUE_SIZE);
+    return io;
+}
+
+// Waits for every read still in flight, the buffers they write to belong to someone else.
+void io_destroy(IoQueue *io) {
+    if (io == NULL) {
+        return;
+    }
+
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+    pthread_mutex_lock(&io->lock);
+    while (io->in_flight > 0) {
+        pthread_cond_wait(&io->done, &io->lock);
+    }
+    io->is_running = false;
+#ifdef IO_URING
+    if (io->is_uring) {
+        io_uring_push(io, IORING_OP_NOP, NULL);
+    }
+#endif
+    pthread_cond_broadcast(&io->work);
+    pthread_mutex_unlock(&io->lock);
+
+    for (uint32 i = 0; i < io->thread_count; i++) {
+        pthread_join(io->threads[i], NULL);
+    }
+#ifdef IO_URING
+    if (io->is_uring) {
+        io_uring_destroy(io);
+    }
+#endif
+    pthread_mutex_destroy(&io->lock);
+    pthread_cond_destroy(&io->done);
+    pthread_cond_destroy(&io->work);
+#endif
+    free(io);
+}
+
+// Queues a read of `size` bytes at `offset` from request->file, or from request->path when there
+// is no file, into request->data. Blocks only when IO_QUEUE_SIZE reads are already in flight.
+void io_read(IoRequest *request) {
+    IoQueue *io = engine()->io;
+    request->bytes = 0;
+    request->error = 0;
+    request->is_owned = false;
+    request->status = IO_PENDING;
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+    request->fd = request->file != NULL ? request->file->fd : -1;
+#endif
+
+#ifdef IO_URING
+    if (io->is_uring && request->file == NULL) {
+        request->fd = open(request->path, O_RDONLY | O_CLOEXEC);
+        if (request->fd < 0) {
+            request->error = errno;
+            __atomic_store_n(&request->status, IO_FAILED, __ATOMIC_RELEASE);
+            return;
+        }
+        request->is_owned = true;
+    }
+#endif
+
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+    pthread_mutex_lock(&io->lock);
+    while (io->in_flight >= IO_QUEUE_SIZE) {
+        pthread_cond_wait(&io->done, &io->lock);
+    }
+    io->in_flight++;
+
+#ifdef IO_URING
+    if (io->is_uring) {
+        if (request->size == 0) {
+            // Nothing to read, a zero length read would just complete as end of file anyway.
+            pthread_mutex_unlock(&io->lock);
+            io_finish(io, request, IO_DONE, 0);
+            return;
+        }
+        io_uring_push(io, IORING_OP_READ, request);
+        pthread_mutex_unlock(&io->lock);
+        return;
+    }
+#endif
+
+    if (io->thread_count == 0) {
+        pthread_mutex_unlock(&io->lock);
+        io_read_blocking(io, request);
+        return;
+    }
+    io->pending[io->tail++ & (IO_QUEUE_SIZE - 1)] = request;
+    pthread_cond_signal(&io->work);
+    pthread_mutex_unlock(&io->lock);
+#else
+    io->in_flight++;
+    io_read_blocking(io, request);
+#endif
+}
+
+IoStatus io_poll(IoRequest *request) {
+    return (IoStatus)__atomic_load_n(&request->status, __ATOMIC_ACQUIRE);
+}
+
+IoStatus io_wait(IoRequest *request) {
+    if (io_poll(request) != IO_PENDING) {
+        return io_poll(request);
+    }
+
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+    IoQueue *io = engine()->io;
+    PROFILE_BEGIN("io wait");
+    pthread_mutex_lock(&io->lock);
+    while (io_poll(request) == IO_PENDING) {
+        pthread_cond_wait(&io->done, &io->lock);
+    }
+    pthread_mutex_unlock(&io->lock);
+    PROFILE_END();
+#endif
+    return io_poll(request);
+}
+
+#endif
@@ -0,0 +1,311 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "core.h"
+#include "log.h"
+
+#include <stdlib.h>
+
+#define JOBS_SPIN_TRIES 256 // failed steal rounds before an idle worker goes to sleep
+
+#if (defined __x86_64__ || defined __i386__)
+#define JOBS_SPIN_RELAX() __builtin_ia32_pause()
+#else
+#define JOBS_SPIN_RELAX()
+#endif
+
+/*
+     ██╗ ██████╗ ██████╗ ███████╗
+     ██║██╔═══██╗██╔══██╗██╔════╝
+     ██║██║   ██║██████╔╝███████╗
+██   ██║██║   ██║██╔══██╗╚════██║
+╚█████╔╝╚██████╔╝██████╔╝███████║
+ ╚════╝  ╚═════╝ ╚═════╝ ╚══════╝
+Every thread that queues or runs jobs owns a deque. Owners push and pop their own end without
+contention, idle threads steal the oldest job from someone else's. Waiting on a counter never
+blocks a thread: it keeps running jobs until the counter drains, so jobs can spawn and wait on
+other jobs without deadlocking the pool. Workers that find nothing to do sleep on a condition
+variable and are woken when new work is queued.
+
+Windows has no workers yet, every job runs inline on the thread that queues it.
+*/
+
+static thread_local JobQueue *jobs_local = NULL;
+static thread_local uint32 jobs_seed = 0;
+
+// Claims a deque for the calling thread the first time it touches the job system.
+static JobQueue *jobs_queue(JobSystem *jobs) {
+    if (jobs_local != NULL) {
+        return jobs_local;
+    }
+
+    uint32 id = __atomic_fetch_add(&jobs->queue_count, 1, __ATOMIC_ACQ_REL);
+    if (id >= JOB_MAX_THREADS) {
+        return NULL;
+    }
+
+    JobQueue *queue = kamalloc_init(JobQueue);
+    __atomic_store_n(&jobs->queues[id], queue, __ATOMIC_RELEASE);
+    jobs_local = queue;
+    jobs_seed = id * 2654435761u + 1;
+    return queue;
+}
+
+static bool jobs_push(JobQueue *queue, Job *job) {
+    int64 bottom = __atomic_load_n(&queue->bottom, __ATOMIC_RELAXED);
+    int64 top = __atomic_load_n(&queue->top, __ATOMIC_ACQUIRE);
+    if (bottom - top >= JOB_QUEUE_SIZE) {
+        return false;
+    }
+
+    queue->jobs[bottom & (JOB_QUEUE_SIZE - 1)] = *job;
+    __atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Owner only. Takes the newest job, which is the one most likely to still be in cache.
+static bool jobs_pop(JobQueue *queue, Job *job) {
+    int64 bottom = __atomic_load_n(&queue->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&queue->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64 top = __atomic_load_n(&queue->top, __ATOMIC_RELAXED);
+
+    if (top > bottom) {
+        __atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    *job = queue->jobs[bottom & (JOB_QUEUE_SIZE - 1)];
+    if (top == bottom) {
+        // Last job left, race any thieves for it.
+        bool won = __atomic_compare_exchange_n(&queue->top, &top, top + 1, false,
+                                               __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        __atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return won;
+    }
+    return true;
+}
+
+static bool jobs_steal(JobQueue *queue, Job *job) {
+    int64 top = __atomic_load_n(&queue->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64 bottom = __atomic_load_n(&queue->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom) {
+        return false;
+    }
+
+    *job = queue->jobs[top & (JOB_QUEUE_SIZE - 1)];
+    return __atomic_compare_exchange_n(&queue->top, &top, top + 1, false, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_RELAXED);
+}
+
+// Own deque first, then everyone else's starting from a random victim so thieves spread out.
+static bool jobs_find(JobSystem *jobs, JobQueue *own, Job *job) {
+    if (own != NULL && jobs_pop(own, job)) {
+        __atomic_fetch_sub(&jobs->pending, 1, __ATOMIC_SEQ_CST);
+        return true;
+    }
+
+    uint32 count = __atomic_load_n(&jobs->queue_count, __ATOMIC_ACQUIRE);
+    if (count > JOB_MAX_THREADS) {
+        count = JOB_MAX_THREADS;
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    jobs_seed ^= jobs_seed << 13;
+    jobs_seed ^= jobs_seed >> 17;
+    jobs_seed ^= jobs_seed << 5;
+    for (uint32 i = 0, start = jobs_seed % count; i < count; i++) {
+        JobQueue *victim = __atomic_load_n(&jobs->queues[(start + i) % count], __ATOMIC_ACQUIRE);
+        if (victim != NULL && victim != own && jobs_steal(victim, job)) {
+            __atomic_fetch_sub(&jobs->pending, 1, __ATOMIC_SEQ_CST);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void jobs_execute(Job *job) {
+    PROFILE_BEGIN("job");
+    job->function(job->data, job->start, job->end);
+    PROFILE_END();
+    if (job->counter != NULL) {
+        __atomic_fetch_sub(&job->counter->value, 1, __ATOMIC_ACQ_REL);
+    }
+}
+
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+static void *jobs_worker(void *arg) {
+    JobSystem *jobs = (JobSystem *)arg;
+    JobQueue *own = jobs_queue(jobs);
+    uint32 tries = 0;
+
+    while (__atomic_load_n(&jobs->is_running, __ATOMIC_ACQUIRE)) {
+        Job job;
+        if (jobs_find(jobs, own, &job)) {
+            jobs_execute(&job);
+            // A worker's frame is one job.
+            arena_frame_reset();
+            tries = 0;
+            continue;
+        }
+        if (++tries < JOBS_SPIN_TRIES) {
+            JOBS_SPIN_RELAX();
+            continue;
+        }
+
+        // Announce we're going to sleep before the last look at pending, so a job queued in
+        // between is either seen here or sees us and signals.
+        pthread_mutex_lock(&jobs->lock);
+        __atomic_fetch_add(&jobs->sleeping, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&jobs->pending, __ATOMIC_SEQ_CST) == 0 &&
+               __atomic_load_n(&jobs->is_running, __ATOMIC_ACQUIRE)) {
+            pthread_cond_wait(&jobs->wake, &jobs->lock);
+        }
+        __atomic_fetch_sub(&jobs->sleeping, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&jobs->lock);
+        tries = 0;
+    }
+
+    arena_thread_release();
+    return NULL;
+}
+#endif
+
+static uint32 jobs_core_count(void) {
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (uint32)cores : 1;
+#else
+    return 1;
+#endif
+}
+
+// Starts `worker_count` workers, or one per core besides the calling thread when it's 0. The
+// calling thread gets a deque too and runs jobs whenever it waits.
+JobSystem *jobs_create(uint32 worker_count) {
+    JobSystem *jobs = kamalloc_init(JobSystem);
+    if (worker_count == 0) {
+        worker_count = jobs_core_count() - 1;
+    }
+    if (worker_count > JOB_MAX_THREADS - 1) {
+        worker_count = JOB_MAX_THREADS - 1;
+    }
+
+    jobs->is_running = true;
+    jobs_queue(jobs);
+
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+    pthread_mutex_init(&jobs->lock, NULL);
+    pthread_cond_init(&jobs->wake, NULL);
+    jobs->workers = calloc(worker_count > 0 ? worker_count : 1, sizeof(pthread_t));
+    for (uint32 i = 0; i < worker_count; i++) {
+        if (pthread_create(&jobs->workers[i], NULL, jobs_worker, jobs) != 0) {
+            log_warning("Unable to start job worker %u, continuing with %u.\n", i, i);
+            break;
+        }
+        jobs->worker_count++;
+    }
+#endif
+
+    log_info("JOBS: %u workers.\n", jobs->worker_count);
+    return jobs;
+}
+
+void jobs_destroy(JobSystem *jobs) {
+    if (jobs == NULL) {
+        return;
+    }
+
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+    pthread_mutex_lock(&jobs->lock);
+    __atomic_store_n(&jobs->is_running, false, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&jobs->wake);
+    pthread_mutex_unlock(&jobs->lock);
+
+    for (uint32 i = 0; i < jobs->worker_count; i++) {
+        pthread_join(jobs->workers[i], NULL);
+    }
+    pthread_mutex_destroy(&jobs->lock);
+    pthread_cond_destroy(&jobs->wake);
+    free(jobs->workers);
+#endif
+
+    uint32 count = jobs->queue_count < JOB_MAX_THREADS ? jobs->queue_count : JOB_MAX_THREADS;
+    for (uint32 i = 0; i < count; i++) {
+        free(jobs->queues[i]);
+    }
+    free(jobs);
+    jobs_local = NULL;
+}
+
+// Queues function(data, start, end). `counter` may be NULL; otherwise it is incremented now and
+// decremented once the job has run.
+void job_run_range(JobFunction function, void *data, uint32 start, uint32 end,
+                   JobCounter *counter) {
+    JobSystem *jobs = engine()->jobs;
+    Job job = {.function = function, .data = data, .start = start, .end = end, .counter = counter};
+    if (counter != NULL) {
+        __atomic_fetch_add(&counter->value, 1, __ATOMIC_ACQ_REL);
+    }
+
+    JobQueue *own = jobs_queue(jobs);
+    if (jobs->worker_count == 0 || own == NULL || !jobs_push(own, &job)) {
+        // No one else to run it, no deque to spare or it's full, doing the work now beats
+        // dropping it.
+        jobs_execute(&job);
+        return;
+    }
+
+    __atomic_fetch_add(&jobs->pending, 1, __ATOMIC_SEQ_CST);
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+    if (__atomic_load_n(&jobs->sleeping, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&jobs->lock);
+        pthread_cond_signal(&jobs->wake);
+        pthread_mutex_unlock(&jobs->lock);
+    }
+#endif
+}
+
+void job_run(JobFunction function, void *data, JobCounter *counter) {
+    job_run_range(function, data, 0, 1, counter);
+}
+
+// Runs other jobs until every job counted by `counter` has finished.
+void job_wait(JobCounter *counter) {
+    JobSystem *jobs = engine()->jobs;
+    JobQueue *own = jobs_queue(jobs);
+
+    while (__atomic_load_n(&counter->value, __ATOMIC_ACQUIRE) > 0) {
+        Job job;
+        if (jobs_find(jobs, own, &job)) {
+            jobs_execute(&job);
+        } else {
+            JOBS_SPIN_RELAX();
+        }
+    }
+}
+
+// Calls function(data, start, end) over [0, count) in batches of `batch` items spread across the
+// workers, and returns once all of them are done. A batch of 0 picks one that gives every thread
+// a few batches to balance out uneven work.
+void job_parallel_for(uint32 count, uint32 batch, JobFunction function, void *data) {
+    if (count == 0) {
+        return;
+    }
+    if (batch == 0) {
+        uint32 threads = engine()->jobs->worker_count + 1;
+        batch = (count + threads * 4 - 1) / (threads * 4);
+    }
+
+    JobCounter counter = {0};
+    for (uint32 start = 0; start < count; start += batch) {
+        uint32 end = count - start > batch ? start + batch : count;
+        job_run_range(function, data, start, end, &counter);
+    }
+    job_wait(&counter);
+}
+
+#endif
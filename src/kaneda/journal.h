@@ -0,0 +1,297 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "core.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JOURNAL_MAGIC 0x4c4e4a4b // "KJNL"
+#define JOURNAL_VERSION 2
+
+/*
+     ██╗ ██████╗ ██╗   ██╗██████╗ ███╗   ██╗ █████╗ ██╗
+     ██║██╔═══██╗██║   ██║██╔══██╗████╗  ██║██╔══██╗██║
+     ██║██║   ██║██║   ██║██████╔╝██╔██╗ ██║███████║██║
+██   ██║██║   ██║██║   ██║██╔══██╗██║╚██╗██║██╔══██║██║
+╚█████╔╝╚██████╔╝╚██████╔╝██║  ██║██║ ╚████║██║  ██║███████╗
+ ╚════╝  ╚═════╝  ╚═════╝ ╚═╝  ╚═╝╚═╝  ╚═══╝╚═╝  ╚═╝╚══════╝
+Records what changed in Input each frame, plus the simulated time step the frame ran with, so a
+session can be replayed frame for frame. Held state is stored as a diff against what was last
+written, so it covers polled devices as well as callbacks, and the frame's drained event stream is
+stored alongside it so input_poll_event() replays too. The whole journal lives in memory and only touches disk at init and shutdown.
+
+File layout, little endian:
+    header: uint32 magic, uint32 version
+    frame:  uint64 step ns, uint16 event count, events
+    event:  uint8 JournalEventType, then its payload
+*/
+
+static void journal_push(InputJournal *journal, const void *data, uint64 size) {
+    if (journal->size + size > journal->capacity) {
+        uint64 capacity = journal->capacity ? journal->capacity * 2 : 4096;
+        while (capacity < journal->size + size) {
+            capacity *= 2;
+        }
+        journal->data = realloc(journal->data, capacity);
+        journal->capacity = capacity;
+    }
+    memcpy(journal->data + journal->size, data, size);
+    journal->size += size;
+}
+
+static bool journal_pull(InputJournal *journal, void *data, uint64 size) {
+    if (journal->cursor + size > journal->size) {
+        return false;
+    }
+    memcpy(data, journal->data + journal->cursor, size);
+    journal->cursor += size;
+    return true;
+}
+
+static void journal_event(InputJournal *journal, JournalEventType type, const void *payload,
+                          uint64 size) {
+    uint8 tag = (uint8)type;
+    journal_push(journal, &tag, sizeof(tag));
+    journal_push(journal, payload, size);
+    journal->frame_events++;
+}
+
+// Starts recording to `path`, or loads `path` for replay. The file is only written at close.
+bool journal_init(InputJournal *journal, const char *path, bool is_replaying) {
+    *journal = (InputJournal){0};
+    journal->path = path;
+
+    if (!is_replaying) {
+        uint32 header[2] = {JOURNAL_MAGIC, JOURNAL_VERSION};
+        journal_push(journal, header, sizeof(header));
+        journal->is_recording = true;
+        return true;
+    }
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        log_error("Unable to open input journal %s.\n", path);
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    journal->data = malloc(size > 0 ? (usize)size : 1);
+    journal->size = journal->capacity = size > 0 ? (uint64)size : 0;
+    if (fread(journal->data, 1, journal->size, fp) != journal->size) {
+        journal->size = 0;
+    }
+    fclose(fp);
+
+    uint32 header[2] = {0};
+    if (!journal_pull(journal, header, sizeof(header)) || header[0] != JOURNAL_MAGIC ||
+        header[1] != JOURNAL_VERSION) {
+        log_error("%s is not a version %d input journal.\n", path, JOURNAL_VERSION);
+        free(journal->data);
+        *journal = (InputJournal){0};
+        return false;
+    }
+
+    journal->is_replaying = true;
+    log_info("JOURNAL: Replaying %s\n", path);
+    return true;
+}
+
+// Appends the difference between `input` and the last recorded state as one frame.
+static void journal_record(InputJournal *journal, Input *input, Time *time) {
+
+    journal_push(journal, &time->step, sizeof(time->step));
+    uint64 count_at = journal->size;
+    journal->frame_events = 0;
+    journal_push(journal, &journal->frame_events, sizeof(journal->frame_events));
+
+    for (uint32 i = 0; i < KEY_BITSET_WORDS; i++) {
+        uint64 current = input->keyboard.key_state_current[i];
+        uint64 changed = current ^ journal->last.keys[i];
+        while (changed != 0) {
+            uint32 bit = __builtin_ctzll(changed);
+            uint16 key = (uint16)(i * 64 + bit);
+            uint8 payload[3] = {key & 0xff, key >> 8, (current >> bit) & 1};
+            journal_event(journal, JOURNAL_KEY, payload, sizeof(payload));
+            changed &= changed - 1;
+        }
+    }
+    for (uint32 i = 0; i < input->events.count; i++) {
+        InputEvent *event = &input->events.data[i];
+        uint8 payload[18] = {(uint8)event->type, (uint8)event->device};
+        memcpy(&payload[2], &event->code, sizeof(int32));
+        memcpy(&payload[6], &event->action, sizeof(int32));
+        memcpy(&payload[10], &event->value.x, sizeof(float));
+        memcpy(&payload[14], &event->value.y, sizeof(float));
+        journal_event(journal, JOURNAL_EVENT, payload, sizeof(payload));
+    }
+
+    uint8 buttons = input->mouse.button_state_current ^ journal->last.buttons;
+    for (uint8 button = 0; button < 8; button++) {
+        if ((buttons >> button) & 1) {
+            uint8 payload[2] = {button, (input->mouse.button_state_current >> button) & 1};
+            journal_event(journal, JOURNAL_MOUSE_BUTTON, payload, sizeof(payload));
+        }
+    }
+    if (input->mouse.position.x != journal->last.position.x ||
+        input->mouse.position.y != journal->last.position.y) {
+        float payload[2] = {input->mouse.position.x, input->mouse.position.y};
+        journal_event(journal, JOURNAL_CURSOR, payload, sizeof(payload));
+    }
+    if (input->mouse.wheel_move_current != 0.0f) {
+        journal_event(journal, JOURNAL_WHEEL, &input->mouse.wheel_move_current, sizeof(float));
+    }
+
+    for (uint8 pad = 0; pad < MAX_GAMEPADS; pad++) {
+        if (input->gamepad.is_ready[pad] != journal->last.is_ready[pad]) {
+            uint8 payload[2] = {pad, input->gamepad.is_ready[pad]};
+            journal_event(journal, JOURNAL_GAMEPAD_READY, payload, sizeof(payload));
+        }
+        for (uint8 button = 0; button < MAX_GAMEPAD_AXES; button++) {
+            if (input->gamepad.button_state_current[pad][button] !=
+                journal->last.button_state[pad][button]) {
+                uint8 payload[3] = {pad, button, input->gamepad.button_state_current[pad][button]};
+                journal_event(journal, JOURNAL_GAMEPAD_BUTTON, payload, sizeof(payload));
+            }
+        }
+        for (uint8 axis = 0; axis < MAX_GAMEPAD_AXES; axis++) {
+            if (input->gamepad.axis_state[pad][axis] != journal->last.axis_state[pad][axis]) {
+                uint8 payload[6] = {pad, axis};
+                memcpy(&payload[2], &input->gamepad.axis_state[pad][axis], sizeof(float));
+                journal_event(journal, JOURNAL_GAMEPAD_AXIS, payload, sizeof(payload));
+            }
+        }
+    }
+
+    memcpy(journal->data + count_at, &journal->frame_events, sizeof(journal->frame_events));
+    memcpy(journal->last.keys, input->keyboard.key_state_current, sizeof(journal->last.keys));
+    journal->last.buttons = input->mouse.button_state_current;
+    journal->last.position = input->mouse.position;
+    memcpy(journal->last.is_ready, input->gamepad.is_ready, sizeof(journal->last.is_ready));
+    memcpy(journal->last.axis_state, input->gamepad.axis_state, sizeof(journal->last.axis_state));
+    memcpy(journal->last.button_state, input->gamepad.button_state_current,
+           sizeof(journal->last.button_state));
+    journal->frames++;
+}
+
+// Applies the next recorded frame to `input` and hands its time step to `time`. Returns false
+// once the journal has run out.
+static bool journal_replay(InputJournal *journal, Input *input, Time *time) {
+    uint64 step = 0;
+    uint16 count = 0;
+    if (!journal_pull(journal, &step, sizeof(step)) ||
+        !journal_pull(journal, &count, sizeof(count))) {
+        return false;
+    }
+
+    // Nothing polls the pads while replaying headless, so latch their previous state here the way
+    // input_update does for keys and mouse. The recorded state wins over anything read live.
+    memcpy(input->gamepad.button_state_previous, journal->last.button_state,
+           sizeof(journal->last.button_state));
+    memcpy(input->gamepad.button_state_current, journal->last.button_state,
+           sizeof(journal->last.button_state));
+
+    for (uint16 i = 0; i < count; i++) {
+        uint8 tag = 0;
+        uint8 payload[8] = {0};
+        uint8 event_payload[18] = {0};
+        InputEvent event = {0};
+        float axis = 0.0f;
+        if (!journal_pull(journal, &tag, sizeof(tag))) {
+            return false;
+        }
+
+        switch ((JournalEventType)tag) {
+        case JOURNAL_KEY:
+            journal_pull(journal, payload, 3);
+            input_set_key(input, payload[0] | (payload[1] << 8), payload[2]);
+            break;
+        case JOURNAL_EVENT:
+            // Held state comes from the diffs, the event only goes into the frame's list.
+            journal_pull(journal, event_payload, sizeof(event_payload));
+            event.time = time_elapsed();
+            event.type = (InputEventType)event_payload[0];
+            event.device = event_payload[1];
+            memcpy(&event.code, &event_payload[2], sizeof(int32));
+            memcpy(&event.action, &event_payload[6], sizeof(int32));
+            memcpy(&event.value.x, &event_payload[10], sizeof(float));
+            memcpy(&event.value.y, &event_payload[14], sizeof(float));
+            input_append_event(input, &event);
+            break;
+        case JOURNAL_MOUSE_BUTTON:
+            journal_pull(journal, payload, 2);
+            input_mouse_set_button(input, payload[0], payload[1]);
+            break;
+        case JOURNAL_CURSOR:
+            journal_pull(journal, &input->mouse.position.x, sizeof(float));
+            journal_pull(journal, &input->mouse.position.y, sizeof(float));
+            break;
+        case JOURNAL_WHEEL:
+            journal_pull(journal, &input->mouse.wheel_move_current, sizeof(float));
+            break;
+        case JOURNAL_GAMEPAD_READY:
+            journal_pull(journal, payload, 2);
+            input->gamepad.is_ready[payload[0] % MAX_GAMEPADS] = payload[1];
+            break;
+        case JOURNAL_GAMEPAD_BUTTON:
+            journal_pull(journal, payload, 3);
+            input->gamepad.button_state_current[payload[0] % MAX_GAMEPADS]
+                                               [payload[1] % MAX_GAMEPAD_AXES] = payload[2];
+            break;
+        case JOURNAL_GAMEPAD_AXIS:
+            journal_pull(journal, payload, 6);
+            memcpy(&axis, &payload[2], sizeof(float));
+            input->gamepad.axis_state[payload[0] % MAX_GAMEPADS][payload[1] % MAX_GAMEPAD_AXES] =
+                axis;
+            break;
+        default:
+            log_error("Corrupt input journal %s at byte %llu.\n", journal->path,
+                      (unsigned long long)journal->cursor);
+            return false;
+        }
+    }
+
+    memcpy(journal->last.button_state, input->gamepad.button_state_current,
+           sizeof(journal->last.button_state));
+    time->step = step;
+    time->delta = step / 1000000000.0;
+    journal->frames++;
+    return true;
+}
+
+// Call once per frame, right after input has been polled and before update().
+void journal_frame(InputJournal *journal, Input *input, Time *time) {
+    if (journal->is_recording) {
+        journal_record(journal, input, time);
+    } else if (journal->is_replaying && !journal_replay(journal, input, time)) {
+        log_info("JOURNAL: Replay finished after %llu frames.\n",
+                 (unsigned long long)journal->frames);
+        journal->is_replaying = false;
+        engine_quit();
+    }
+}
+
+// Writes out a recording and frees the journal.
+void journal_close(InputJournal *journal) {
+    if (journal->is_recording) {
+        FILE *fp = fopen(journal->path, "wb");
+        if (fp == NULL) {
+            log_error("Unable to open %s to write the input journal.\n", journal->path);
+        } else {
+            fwrite(journal->data, 1, journal->size, fp);
+            fclose(fp);
+            log_info("JOURNAL: Wrote %llu frames (%llu bytes) to %s\n",
+                     (unsigned long long)journal->frames, (unsigned long long)journal->size,
+                     journal->path);
+        }
+    }
+
+    free(journal->data);
+    *journal = (InputJournal){0};
+}
+
+#endif
@@ -2,6 +2,9 @@
 #define KANEDA_H
 
 #include "core.h"
+#include "file.h"
+#include "pack.h"
+#include "shader.h"
 
 /*
 ███████╗████████╗██████╗ ██╗   ██╗ ██████╗████████╗███████╗
@@ -22,24 +25,83 @@ typedef struct Game {
     uint32 window_width;
     uint32 window_height;
     float32 frame_rate;
+    float32 tick_rate;          // fixed simulation ticks per second, 0 runs update once per frame
+    uint32 max_ticks_per_frame; // catch-up limit before unsimulated time gets dropped
+    const char *trace_path;     // profiler trace written here at shutdown, NULL to skip
+    const char *stats_path;     // frame statistics CSV written here at shutdown, NULL to skip
+    uint32 stats_capacity;      // frames of history kept for frame statistics
+    uint32 worker_count;        // job worker threads, 0 for one per core besides the main thread
+    void (*snapshot)(void *dest); // sim thread mode: copy what draw() needs into dest
+    uint32 snapshot_size;         // bytes snapshot() writes
+    const char *record_path;    // input journal recorded here at shutdown, NULL to skip
+    const char *replay_path;    // input journal replayed from here, the game quits when it ends
+    uint32 entity_size;         // bytes per game entity
+    uint32 max_entities;        // entities alive at once, 0 skips the entity pool
+    usize memory_budgets[MEM_TAG_COUNT]; // bytes per MemTag before the tracker warns, 0 for none
+    const char *pack_path;      // asset pack opened at startup, NULL loads every asset from disk
 
     struct {
         bool is_resizable;
         bool is_fullscreen;
         bool vsync_on;
+        bool is_headless;       // no window or GL context, frames run as fast as update() allows
+        bool use_virtual_clock; // simulation advances exactly 1/frame_rate per frame
+        bool use_sim_thread;    // update() runs on its own thread, draw() reads snapshots
+        bool use_hot_reload;    // rebuild shader programs when their sources change on disk
     } flags;
 } Game;
 
-typedef struct Input {
-    struct {
-        char key_state_current[512];  // registers current frame key-state
-        char key_state_previous[512]; // registers previous frame key-state
+typedef enum InputEventType {
+    INPUT_EVENT_KEY,            // code is the key, action GLFW_PRESS/RELEASE/REPEAT
+    INPUT_EVENT_CHAR,           // code is the unicode codepoint
+    INPUT_EVENT_MOUSE_BUTTON,   // code is the button, action GLFW_PRESS/RELEASE
+    INPUT_EVENT_MOUSE_MOVE,     // value is the cursor position
+    INPUT_EVENT_MOUSE_SCROLL,   // value is the wheel offset
+    INPUT_EVENT_CURSOR_ENTER,   // action is 1 when the cursor entered the window
+    INPUT_EVENT_GAMEPAD_BUTTON, // device is the gamepad, code the button, action GLFW_PRESS/RELEASE
+    INPUT_EVENT_WINDOW_RESIZE,  // value is the new size
+    INPUT_EVENT_WINDOW_FOCUS,   // action is 1 when focus was gained
+    INPUT_EVENT_WINDOW_ICONIFY, // action is 1 when minimized
+    INPUT_EVENT_WINDOW_MAXIMIZE // action is 1 when maximized
+} InputEventType;
+
+typedef struct InputEvent {
+    uint64 time; // time_elapsed() when the event was produced
+    InputEventType type;
+    int32 device;
+    int32 code;
+    int32 action;
+    vec2 value;
+} InputEvent;
 
-        int32 key_pressed_queue[MAX_KEYS_PRESSABLE]; // Input keys queue
-        uint32 num_keys_pressed;                     // Input keys queue count
+// Single producer, single consumer. Each index is only ever stored by its own side, so the two
+// never need a lock, and they sit on separate cache lines so they don't bounce between cores.
+typedef struct InputEventQueue {
+    uint32 head; // next slot the producer writes
+    uint8 head_pad[60];
+    uint32 tail; // next slot the consumer reads
+    uint8 tail_pad[60];
+    uint32 dropped; // events lost to a full queue, written by the producer only
+    InputEvent events[INPUT_EVENT_QUEUE_SIZE];
+} InputEventQueue;
 
-        int32 char_pressed_queue[MAX_CHAR_PRESSED_QUEUE]; // Input characters queue
-        uint32 num_chars_pressed;                         // Input characters queue count
+typedef struct Input {
+    InputEventQueue queue; // filled by callbacks, drained into events once per frame
+    struct {
+        InputEvent *data; // everything drained this frame, oldest first
+        uint32 count;
+        uint32 capacity;
+        uint32 read;      // next event input_poll_event() hands out
+        uint32 key_read;  // next event input_get_last_key_pressed() looks at
+        uint32 char_read; // next event input_get_last_char_pressed() looks at
+    } events;
+    struct {
+        // One bit per key code. pressed and released are worked out once per frame after polling,
+        // so edge queries are a single bit test.
+        uint64 key_state_current[KEY_BITSET_WORDS];  // keys held down this frame
+        uint64 key_state_previous[KEY_BITSET_WORDS]; // keys held down last frame
+        uint64 key_pressed[KEY_BITSET_WORDS];        // keys that went down this frame
+        uint64 key_released[KEY_BITSET_WORDS];       // keys that went up this frame
     } keyboard;
     struct {
         vec2 position;
@@ -48,8 +110,10 @@ typedef struct Input {
         bool is_cursor_hidden;
         bool is_cursor_inside_client;
 
-        char button_state_current[5];
-        char button_state_previous[5];
+        uint8 button_state_current;  // one bit per button, GLFW has 8
+        uint8 button_state_previous;
+        uint8 button_pressed;
+        uint8 button_released;
         float wheel_move_current;  // registers current mouse wheel variation
         float wheel_move_previous; // registers previous mouse wheel variation
     } mouse;
@@ -66,16 +130,150 @@ typedef struct Input {
     } gamepad;
 } Input;
 
+typedef enum JournalEventType {
+    JOURNAL_KEY,
+    JOURNAL_EVENT,
+    JOURNAL_MOUSE_BUTTON,
+    JOURNAL_CURSOR,
+    JOURNAL_WHEEL,
+    JOURNAL_GAMEPAD_READY,
+    JOURNAL_GAMEPAD_BUTTON,
+    JOURNAL_GAMEPAD_AXIS
+} JournalEventType;
+
+typedef struct InputJournal {
+    const char *path;
+    bool is_recording;
+    bool is_replaying;
+
+    uint8 *data;
+    uint64 size;
+    uint64 capacity;
+    uint64 cursor; // replay read position in data
+
+    uint64 frames;       // frames recorded or replayed so far
+    uint16 frame_events; // events in the frame being recorded
+
+    struct {
+        uint64 keys[KEY_BITSET_WORDS];
+        uint8 buttons;
+        vec2 position;
+        bool is_ready[MAX_GAMEPADS];
+        float axis_state[MAX_GAMEPADS][MAX_GAMEPAD_AXES];
+        char button_state[MAX_GAMEPADS][MAX_GAMEPAD_AXES];
+    } last; // input as of the last recorded frame
+} InputJournal;
+
 typedef struct Time {
-    float64 fps_limit;
-    float64 current;
-    float64 previous;
-    float64 update;
-    float64 render;
-    float64 delta;
-    float64 frame;
+    // Everything below is integer nanoseconds unless noted, so nothing drifts over long sessions.
+    float64 fps_limit; // frames per second, as configured
+    uint64 start;      // raw clock reading when the engine came up
+    uint64 current;
+    uint64 previous;
+    uint64 update;
+    uint64 render;
+    uint64 frame;
+    uint64 gpu;    // GPU time of all timed passes, GPU_TIMER_LATENCY - 1 frames behind
+    uint64 step;   // simulated time the last frame advanced by, frame unless the clock is virtual
+    float64 delta; // step in seconds
+
+    uint64 tick;        // fixed simulation step, 0 when running variable
+    uint64 accumulator; // wall time not yet consumed by fixed ticks
+    float64 alpha;      // how far draw() sits between the last two ticks [0..1)
+    uint32 ticks;       // number of fixed ticks run this frame
+
+    bool is_virtual;      // the simulation ignores the wall clock and steps by virtual_step
+    uint64 virtual_step;
 } Time;
 
+typedef enum FrameStat {
+    FRAME_STAT_FRAME,
+    FRAME_STAT_UPDATE,
+    FRAME_STAT_RENDER,
+    FRAME_STAT_GPU,
+    FRAME_STAT_COUNT
+} FrameStat;
+
+typedef struct FrameSummary {
+    uint64 min;
+    uint64 max;
+    float64 mean;
+    uint64 p50;
+    uint64 p95;
+    uint64 p99;
+    uint64 p999;
+} FrameSummary;
+
+typedef struct FrameStats {
+    uint64 *samples[FRAME_STAT_COUNT]; // one ring per measurement, all in ns
+    uint64 *scratch;                   // sort space for percentiles
+    uint32 capacity;
+    uint32 count; // valid samples in each ring
+    uint32 head;  // slot the next frame is written to
+    uint64 frames;
+    uint64 hitch_threshold; // frames longer than this count as hitches
+    uint64 hitches;
+} FrameStats;
+
+typedef struct Pacer {
+    int64 period;   // target frame length in ns, 0 leaves the frame rate uncapped
+    int64 deadline; // absolute time the current frame should end
+    int64 margin;   // how long before a deadline the sleep wakes up to start spinning
+    int64 slack;    // decaying peak of how late the OS wakes us from a sleep
+
+    struct {
+        uint64 frames; // frames paced so far
+        uint64 missed; // frames that were already past their deadline
+        int64 last;    // lateness of the last frame past its deadline
+        int64 max;     // worst lateness seen
+        int64 total;   // sum of lateness, for the mean
+        int64 spin;    // time the last wait spent spinning
+    } stats;
+} Pacer;
+
+typedef struct ProfileZone {
+    const char *name;
+    uint64 begin;
+    uint64 end;
+    uint32 depth;
+} ProfileZone;
+
+typedef struct ProfileCounter {
+    const char *name;
+    uint64 time;
+    float64 value;
+} ProfileCounter;
+
+typedef struct ProfileThread {
+    uint32 id;
+    uint32 depth;        // zones currently open
+    uint64 head;         // zones ever written, the ring slot is head % PROFILER_RING_SIZE
+    uint64 counter_head; // counter samples ever written
+
+    struct {
+        const char *name;
+        uint64 begin;
+    } stack[PROFILER_MAX_DEPTH];
+
+    ProfileZone zones[PROFILER_RING_SIZE];
+    ProfileCounter counters[PROFILER_COUNTER_RING_SIZE];
+} ProfileThread;
+
+// Memory use as of the last finished frame. Tag and allocation numbers come from the allocation
+// tracker and stay 0 unless MEMORY_DEBUG is on, resident sizes come from the OS.
+typedef struct MemStats {
+    MemTagStats tags[MEM_TAG_COUNT];
+    uint64 frame_allocations;      // allocations made during the last frame, on any thread
+    uint64 frame_bytes;            // bytes those allocations asked for
+    uint64 peak_frame_allocations; // most allocations any single frame has made
+    uint64 peak_frame_bytes;
+    uint64 frame_arena; // bytes the main thread's frame arena handed out by the end of the frame
+    uint64 resident;    // resident set size in bytes
+    uint64 peak_resident;
+    int32 statm; // /proc/self/statm, kept open so sampling is one read
+    bool is_tracked;
+} MemStats;
+
 typedef struct Platform {
     struct {
         GLFWwindow *handle;
@@ -94,6 +292,10 @@ typedef struct Platform {
 
     Input input;
     Time time;
+    Pacer pacer;
+    FrameStats stats;
+    MemStats memory;
+    InputJournal journal;
 
     // Event *events;
     // Cursor *cursors;
@@ -102,19 +304,261 @@ typedef struct Platform {
 typedef struct Audio {
 } Audio;
 
+// Triple buffer between the simulation thread and the render thread. Each side always owns one
+// slot and the third is handed back and forth through `ready`, so neither ever waits on the other
+// and draw() always sees a complete snapshot.
+typedef struct SimThread {
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+    pthread_t thread;
+#endif
+    bool is_running;
+    Pacer pacer; // paces the simulation at the tick rate
+
+    uint32 size; // bytes per snapshot
+    uint8 *slots[3];
+    uint64 published[3]; // time_elapsed() when each slot was published, 0 if never
+    uint32 write;        // slot the simulation fills next, sim thread only
+    uint32 read;         // slot draw() is reading, render thread only
+    uint32 ready;        // newest published slot, SIM_SNAPSHOT_FRESH until the renderer takes it
+    uint64 snapshots;    // snapshots published so far
+
+    // The simulation's own clock, sim thread only. The update time and step behind each slot go
+    // out with it and land in the platform's Time when the renderer takes the slot.
+    Time time;
+    uint64 updates[3];
+    uint64 steps[3];
+} SimThread;
+
+// Jobs get a [start, end) range so parallel_for batches and single jobs share one signature.
+typedef void (*JobFunction)(void *data, uint32 start, uint32 end);
+
+typedef struct JobCounter {
+    int32 value; // jobs still outstanding, waiters return once it reaches 0
+} JobCounter;
+
+typedef struct Job {
+    JobFunction function;
+    void *data;
+    uint32 start;
+    uint32 end;
+    JobCounter *counter;
+} Job;
+
+// Chase-Lev deque. The owning thread pushes and pops at bottom, everyone else steals from top.
+typedef struct JobQueue {
+    int64 top;
+    uint8 top_pad[56];
+    int64 bottom;
+    uint8 bottom_pad[56];
+    Job jobs[JOB_QUEUE_SIZE];
+} JobQueue;
+
+typedef struct JobSystem {
+    JobQueue *queues[JOB_MAX_THREADS]; // one per thread that has queued or run a job
+    uint32 queue_count;
+    uint32 worker_count;
+
+    bool is_running;
+    int32 pending;  // jobs sitting in any queue
+    int32 sleeping; // workers parked on wake
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+    pthread_t *workers;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+#endif
+} JobSystem;
+
+typedef enum IoStatus {
+    IO_PENDING,
+    IO_DONE,
+    IO_FAILED,
+} IoStatus;
+
+// One read handed to the I/O queue. The caller owns it and has to keep it and `data` alive until
+// io_poll() stops returning IO_PENDING.
+typedef struct IoRequest {
+    const char *path; // opened for this read and closed after, ignored when `file` is set
+    file file;
+    uint64 offset;
+    uint64 size;
+    void *data;
+
+    uint64 bytes;  // bytes read, less than size once done if the file ended first
+    int32 error;   // errno of a failed read
+    int32 status;  // IoStatus, only read it through io_poll()/io_wait()
+    int fd;        // descriptor the read goes through, I/O queue only
+    bool is_owned; // fd was opened from `path` and gets closed when the read finishes
+} IoRequest;
+
+typedef struct IoQueue {
+    bool is_running;
+    bool is_uring;
+    uint32 in_flight; // submitted and not finished yet, never more than IO_QUEUE_SIZE
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+    pthread_mutex_t lock;
+    pthread_cond_t done; // broadcast whenever a request finishes
+    pthread_cond_t work; // wakes the fallback workers
+    pthread_t threads[IO_WORKER_COUNT];
+#endif
+    uint32 thread_count;
+
+    // Worker threads: requests waiting for a worker.
+    IoRequest *pending[IO_QUEUE_SIZE];
+    uint32 head;
+    uint32 tail;
+
+    // io_uring: the shared rings and pointers into them.
+    int ring;
+    void *sq_ring;
+    usize sq_ring_size;
+    void *cq_ring;
+    usize cq_ring_size;
+    void *sqes;
+    usize sqes_size;
+    uint32 *sq_head;
+    uint32 *sq_tail;
+    uint32 *sq_mask;
+    uint32 *sq_array;
+    uint32 *cq_head;
+    uint32 *cq_tail;
+    uint32 *cq_mask;
+    void *cqes;
+} IoQueue;
+
+// A whole asset being read through the I/O queue, see asset_load_async(). The caller keeps it
+// alive until asset_finish() has been called on it.
+typedef struct AssetRequest {
+    IoRequest io;
+    const char *name;
+    file file;    // loose file being read, NULL when the asset comes from the pack
+    uint8 *data;  // size + 1 bytes, handed over by asset_finish()
+    uint8 *block; // LZ4 block read from the pack, NULL when the bytes are stored as is
+    uint64 size;  // unpacked size
+} AssetRequest;
+
+typedef struct GpuPass {
+    const char *name;
+    GLuint queries[GPU_TIMER_LATENCY];
+    bool is_pending[GPU_TIMER_LATENCY];
+    uint64 elapsed; // last resolved GPU time in ns
+    uint64 samples; // queries resolved so far
+} GpuPass;
+
+typedef struct GpuTimer {
+    GpuPass passes[GPU_TIMER_MAX_PASSES];
+    uint32 pass_count;
+    int32 active; // pass with an open query, -1 if none
+    uint32 frame; // picks the query slot passes write to this frame
+    uint64 total; // sum of the passes resolved at the last gpu_timer_frame()
+    bool is_supported;
+} GpuTimer;
+
+// Generational pool handles, see Pool in core.h. An id of 0 never refers to anything.
+typedef struct MeshHandle {
+    uint32 id;
+} MeshHandle;
+
+typedef struct TextureHandle {
+    uint32 id;
+} TextureHandle;
+
+typedef struct ShaderHandle {
+    uint32 id;
+} ShaderHandle;
+
+typedef struct EntityHandle {
+    uint32 id;
+} EntityHandle;
+
+typedef struct Vertex {
+    vec3 position;
+    vec3 normal;
+    vec2 tex_coords;
+} Vertex;
+
+typedef struct Texture {
+    uint32 id;
+    const char *type;
+} Texture;
+
+typedef struct Mesh {
+    Vertex *vertices;        // stretchy buffer, still owned by the caller
+    uint32 *indices;         // stretchy buffer, still owned by the caller
+    TextureHandle *textures; // stretchy buffer, still owned by the caller
+
+    uint32 vao;
+    uint32 vbo;
+    uint32 ebo;
+} Mesh;
+
+// One GL buffer cut into UNIFORM_BUFFER_FRAMES regions. Each frame maps the next region and writes
+// its uniform blocks into it while the GPU may still be reading the others, a fence per region
+// keeps the CPU from lapping the GPU.
+typedef struct UniformBuffer {
+    GLuint buffer;
+    usize size;      // bytes per region
+    usize alignment; // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, every block starts on it
+    uint32 region;   // region this frame writes
+    usize used;      // bytes written into it so far
+    uint8 *mapped;   // the region while it's mapped, NULL outside begin/end
+    GLsync fences[UNIFORM_BUFFER_FRAMES];
+} UniformBuffer;
+
+#define UNIFORM_BUFFER_FULL ((usize)-1) // offset uniform_buffer_push() gives when there's no room
+
+// One draw waiting in the render queue. The key decides the order, the rest is what replaying it
+// needs.
+typedef struct RenderCommand {
+    uint64 key;
+    MeshHandle mesh;
+    ShaderHandle shader;
+    usize object; // graphics_push_object() offset of its Object block
+} RenderCommand;
+
+// Draws submitted with graphics_draw(), sorted and replayed by graphics_render().
+typedef struct RenderQueue {
+    RenderCommand *commands;
+    RenderCommand *sorted; // the radix sort goes back and forth between the two
+    uint32 count;
+    uint16 back_to_front; // bit per pass, set by graphics_pass_back_to_front()
+    bool is_full;         // dropped draws this frame, logged once
+} RenderQueue;
+
+// Watches the directories shader sources live in rather than the files, editors often save by
+// writing a new file and renaming it over the old one.
+typedef struct ShaderWatcher {
+    int fd; // inotify descriptor, -1 when not watching
+    int watches[SHADER_WATCH_MAX_DIRS];
+    char prefixes[SHADER_WATCH_MAX_DIRS][128]; // the directory as it starts shader paths, "" for .
+    uint32 count;
+} ShaderWatcher;
+
 typedef struct Graphics {
+    GpuTimer timer;
+    UniformBuffer uniforms;
+    ShaderWatcher watcher;
+    RenderQueue queue;
+    Pool meshes;
+    Pool textures;
+    Pool shaders;
 } Graphics;
 
 typedef struct Engine {
     Platform *platform;
     Graphics *graphics;
     Audio *audio;
+    JobSystem *jobs;
+    IoQueue *io;
+    pack assets; // NULL unless the game gave a pack_path
+    SimThread *sim; // NULL unless update() runs on its own thread
+    Pool entities;  // empty unless the game asked for max_entities
     Game game;
     void (*shutdown)();
 } Engine;
 
 // GLOBAL INSTANCE ---------------------
 static Engine *engine_instance = {0};
+static thread_local Time *engine_time_local = NULL; // set on the sim thread, see engine_time()
 Engine *engine(void) {
     return engine_instance;
 }
@@ -127,7 +571,8 @@ Input *input(void) {
     return &engine()->platform->input;
 }
 
-Time *time(void) {
+// Not time(), that would shadow libc's time() for the whole program.
+Time *timer(void) {
     return &engine()->platform->time;
 }
 // -------------------------------------
@@ -150,15 +595,25 @@ Engine *engine(void);
 Game *game(void);
 Engine *engine_create(Game game);
 void engine_frame(void);
+bool engine_simulate(Time *time, bool is_threaded);
+const void *engine_snapshot(void);
+Time *engine_time(void);
 bool game_is_running(void);
-void engine_sleep(float ms);
+void engine_quit(void);
+void engine_sleep(float64 ms);
 void engine_destroy(void);
+void *asset_load(const char *name, uint64 *size);
+bool asset_load_async(AssetRequest *request, const char *name);
+bool asset_is_loaded(AssetRequest *request);
+void *asset_finish(AssetRequest *request, uint64 *size);
 // -----------------------------------------
 
 // PLATFORM DEFINITIONS---------------------
 extern Platform *platform_create(void);
 extern void platform_open_window(const char *title, const uint32 width, const uint32 height);
 extern void platform_update(Platform *platform);
+extern void platform_poll_events(Platform *platform);
+extern void platform_update_input(Platform *platform, Time *time);
 extern void platform_destroy(Platform *platform);
 extern void platform_window_add_flag(uint32 flag);
 extern void platform_window_remove_flag(uint32 flag);
@@ -168,11 +623,54 @@ extern bool platform_window_has_flag(uint32 flag);
 extern bool is_fullscreen(void);
 extern bool is_resizable(void);
 extern bool is_vsync_on(void);
+extern bool is_headless(void);
 // -----------------------------------------
 
 // GRAPHICS DEFINITIONS --------------------
 extern Graphics *graphics_create();
 extern void graphics_destroy(Graphics *graphics);
+extern void graphics_pass_begin(const char *name);
+extern void graphics_pass_end(void);
+extern uint64 graphics_pass_time(const char *name);
+extern bool uniform_buffer_create(UniformBuffer *buffer, usize size);
+extern void uniform_buffer_destroy(UniformBuffer *buffer);
+extern bool uniform_buffer_begin(UniformBuffer *buffer);
+extern usize uniform_buffer_push(UniformBuffer *buffer, const void *data, usize size);
+extern void uniform_buffer_end(UniformBuffer *buffer);
+extern void uniform_buffer_bind(UniformBuffer *buffer, GLuint binding, usize offset, usize size);
+extern void graphics_uniforms_begin(void);
+extern void graphics_uniforms_end(void);
+extern void graphics_set_frame(const FrameUniforms *frame);
+extern usize graphics_push_object(const ObjectUniforms *object);
+extern void graphics_bind_object(usize offset);
+extern ShaderHandle shader_load(const char *vert_path, const char *frag_path,
+                                const char *geom_path, const char *defines);
+extern Shader *shader_get(ShaderHandle handle);
+extern void shader_unload(ShaderHandle handle);
+extern void graphics_hot_reload(void);
+extern void graphics_draw(uint32 pass, MeshHandle mesh, ShaderHandle shader, usize object,
+                          float32 depth);
+extern void graphics_pass_back_to_front(uint32 pass, bool is_back_to_front);
+extern void graphics_render(void);
+// -----------------------------------------
+
+// MESH DEFINITIONS ------------------------
+extern TextureHandle texture_create(uint32 id, const char *type);
+extern Texture *texture_get(TextureHandle handle);
+extern void texture_destroy(TextureHandle handle);
+extern MeshHandle mesh_create(Vertex *vertices, uint32 *indices, TextureHandle *textures);
+extern Mesh *mesh_get(MeshHandle handle);
+extern void mesh_destroy(MeshHandle handle);
+extern void mesh_draw(MeshHandle handle, Shader *shader);
+// -----------------------------------------
+
+// GPU TIMER DEFINITIONS -------------------
+extern void gpu_timer_init(GpuTimer *timer);
+extern void gpu_timer_begin(GpuTimer *timer, const char *name);
+extern void gpu_timer_end(GpuTimer *timer);
+extern void gpu_timer_frame(GpuTimer *timer);
+extern uint64 gpu_timer_get(GpuTimer *timer, const char *name);
+extern void gpu_timer_destroy(GpuTimer *timer);
 // -----------------------------------------
 
 // AUDIO DEFINITIONS -----------------------
@@ -183,6 +681,14 @@ extern void audio_destroy(Audio *audio);
 // INPUT DEFINITIONS -----------------------
 extern void input_update(Input *input);
 extern void input_process(Input *input);
+extern void input_latch(Input *input);
+extern bool input_push_event(InputEventQueue *queue, InputEvent event);
+extern void input_drain(Input *input);
+extern void input_append_event(Input *input, InputEvent *event);
+extern bool input_poll_event(InputEvent *event);
+extern void input_set_key(Input *input, int key, bool is_down);
+extern void input_mouse_set_button(Input *input, int button, bool is_down);
+extern uint32 input_get_changed_keys(int *keys, uint32 max);
 extern bool input_is_key_pressed(int key);
 extern bool input_is_key_down(int key);
 extern bool input_is_key_released(int key);
@@ -210,9 +716,98 @@ extern void input_mouse_set_cursor(int cursor);
 // -----------------------------------------
 
 // TIME DEFINITIONS ------------------------
-extern float64 time_elapsed(void);
+extern uint64 time_now(void);
+extern uint64 time_elapsed(void);
 extern float64 time_get_fps(void);
 extern float64 time_delta(void);
+extern float64 time_alpha(void);
+extern FrameSummary time_get_summary(FrameStat stat);
+extern uint64 time_get_hitches(void);
+// -----------------------------------------
+
+// STATS DEFINITIONS -----------------------
+extern void stats_init(FrameStats *stats, uint32 capacity, uint64 hitch_threshold);
+extern void stats_record(FrameStats *stats, Time *time);
+extern FrameSummary stats_summary(FrameStats *stats, FrameStat stat);
+extern float64 stats_recent_mean(FrameStats *stats, FrameStat stat, uint32 frames);
+extern void stats_log(FrameStats *stats);
+extern bool stats_dump_csv(FrameStats *stats, const char *path);
+extern void stats_destroy(FrameStats *stats);
+// -----------------------------------------
+
+// MEMORY STATS DEFINITIONS ----------------
+extern MemStats *mem_stats(void);
+extern void mem_stats_init(MemStats *stats, usize *budgets);
+extern void mem_stats_frame(MemStats *stats);
+extern void mem_stats_log(MemStats *stats);
+extern void mem_stats_destroy(MemStats *stats);
+// -----------------------------------------
+
+// PACER DEFINITIONS -----------------------
+extern void pacer_init(Pacer *pacer, float64 frame_rate);
+extern void pacer_sleep_until(Pacer *pacer, int64 target);
+extern void pacer_wait(Pacer *pacer);
+extern float64 pacer_mean_overshoot(Pacer *pacer);
+extern void pacer_log_stats(Pacer *pacer);
+// -----------------------------------------
+
+// JOURNAL DEFINITIONS ---------------------
+extern bool journal_init(InputJournal *journal, const char *path, bool is_replaying);
+extern void journal_frame(InputJournal *journal, Input *input, Time *time);
+extern void journal_close(InputJournal *journal);
+// -----------------------------------------
+
+// JOB DEFINITIONS -------------------------
+extern JobSystem *jobs_create(uint32 worker_count);
+extern void jobs_destroy(JobSystem *jobs);
+extern void job_run(JobFunction function, void *data, JobCounter *counter);
+extern void job_run_range(JobFunction function, void *data, uint32 start, uint32 end,
+                          JobCounter *counter);
+extern void job_wait(JobCounter *counter);
+extern void job_parallel_for(uint32 count, uint32 batch, JobFunction function, void *data);
+// -----------------------------------------
+
+// IO DEFINITIONS --------------------------
+extern IoQueue *io_create(void);
+extern void io_destroy(IoQueue *io);
+extern void io_read(IoRequest *request);
+extern IoStatus io_poll(IoRequest *request);
+extern IoStatus io_wait(IoRequest *request);
+// -----------------------------------------
+
+// ENTITY DEFINITIONS ----------------------
+extern EntityHandle entity_create(void);
+extern void *entity_get(EntityHandle handle);
+extern void entity_destroy(EntityHandle handle);
+extern uint32 entity_count(void);
+extern void *entity_at(uint32 i);
+extern EntityHandle entity_handle_at(uint32 i);
+// -----------------------------------------
+
+// SIM THREAD DEFINITIONS ------------------
+extern SimThread *sim_create(uint32 snapshot_size);
+extern void sim_publish(SimThread *sim);
+extern bool sim_acquire(SimThread *sim);
+extern float64 sim_alpha(SimThread *sim);
+extern void sim_destroy(SimThread *sim);
+// -----------------------------------------
+
+// PROFILER DEFINITIONS --------------------
+#ifdef PROFILER
+#define PROFILE_BEGIN(name) profiler_begin(name)
+#define PROFILE_END() profiler_end()
+#define PROFILE_COUNTER(name, value) profiler_counter(name, value)
+#else
+#define PROFILE_BEGIN(name)
+#define PROFILE_END()
+#define PROFILE_COUNTER(name, value)
+#endif
+
+extern void profiler_begin(const char *name);
+extern void profiler_end(void);
+extern void profiler_counter(const char *name, float64 value);
+extern bool profiler_dump(const char *path);
+extern void profiler_destroy(void);
 // -----------------------------------------
 
 /*
@@ -229,15 +824,21 @@ void game_default_function(void) {
 }
 
 bool game_is_running(void) {
+    // engine_quit() can come from the sim thread, when a replay runs out for one.
+    bool is_running = __atomic_load_n(&engine()->game.is_running, __ATOMIC_ACQUIRE);
+    if (engine()->game.flags.is_headless) {
+        return is_running;
+    }
+
 #ifdef PLATFORM_WINDOWS
     if (PeekMessage(&engine()->platform->win32.msg, NULL, 0, 0, PM_REMOVE)) {
         TranslateMessage(&engine()->platform->win32.msg);
         DispatchMessage(&engine()->platform->win32.msg);
     }
 
-    return engine()->game.is_running && engine()->platform->win32.msg.message != WM_QUIT;
+    return is_running && engine()->platform->win32.msg.message != WM_QUIT;
 #else
-    return engine()->game.is_running && !glfwWindowShouldClose(engine()->platform->window.handle);
+    return is_running && !glfwWindowShouldClose(engine()->platform->window.handle);
 #endif
 }
 
@@ -265,6 +866,15 @@ Engine *engine_create(Game game) {
         if (game.frame_rate <= 0.f) {
             game.frame_rate = 60.f;
         }
+        if (game.tick_rate < 0.f) {
+            game.tick_rate = 0.f;
+        }
+        if (game.max_ticks_per_frame == 0) {
+            game.max_ticks_per_frame = 5;
+        }
+        if (game.stats_capacity == 0) {
+            game.stats_capacity = 1024;
+        }
         if (game.update == NULL) {
             game.update = &game_default_function;
         }
@@ -283,94 +893,382 @@ Engine *engine_create(Game game) {
         engine()->shutdown = &engine_destroy;
 
         // Subsystem setup --------------------
+        mem_tag_push(MEM_TAG_PLATFORM);
         engine()->platform = platform_create();
+        // Reserve the main thread's arenas now rather than inside whichever callback asks first.
+        arena_frame();
+        arena_scratch();
+        engine()->platform->time.start = time_now();
         engine()->platform->time.fps_limit = game.frame_rate;
-        platform_open_window(game.window_title, game.window_width, game.window_height);
-        engine()->graphics = graphics_create();
+        if (game.flags.use_virtual_clock) {
+            engine()->platform->time.is_virtual = true;
+            engine()->platform->time.virtual_step = (uint64)(1000000000.0 / game.frame_rate);
+        }
+        // Headless runs are benchmarks and soak tests, there's no display to pace for.
+        pacer_init(&engine()->platform->pacer, game.flags.is_headless ? 0.0 : game.frame_rate);
+        // Anything taking twice the frame budget is a visible stutter.
+        stats_init(&engine()->platform->stats, game.stats_capacity,
+                   (uint64)(2000000000.0 / game.frame_rate));
+        mem_stats_init(&engine()->platform->memory, game.memory_budgets);
+        if (game.tick_rate > 0.f) {
+            engine()->platform->time.tick = (uint64)(1000000000.0 / game.tick_rate);
+        }
+        if (!game.flags.is_headless) {
+            platform_open_window(game.window_title, game.window_width, game.window_height);
+            mem_tag_push(MEM_TAG_GRAPHICS);
+            engine()->graphics = graphics_create();
+            mem_tag_pop();
+        }
+        mem_tag_push(MEM_TAG_AUDIO);
         engine()->audio = audio_create();
+        mem_tag_pop();
+        engine()->jobs = jobs_create(game.worker_count);
+        engine()->io = io_create();
+        if (game.pack_path != NULL) {
+            mem_tag_push(MEM_TAG_ASSETS);
+            engine()->assets = pack_open(game.pack_path);
+            mem_tag_pop();
+            // Hot reload watches loose files, the packed copies would never change.
+            if (!game.flags.use_hot_reload) {
+                shader_use_pack(engine()->assets);
+            }
+        }
+        mem_tag_push(MEM_TAG_GAME);
+        if (game.max_entities > 0) {
+            pool_create(&engine()->entities, "entities", game.entity_size, game.max_entities);
+        }
+        mem_tag_pop();
+        if (game.replay_path != NULL) {
+            if (!game.flags.is_headless) {
+                log_warning("Replaying input with a window open, live input will mix in.\n");
+            }
+            journal_init(&engine()->platform->journal, game.replay_path, true);
+        } else if (game.record_path != NULL) {
+            journal_init(&engine()->platform->journal, game.record_path, false);
+        }
+        mem_tag_pop();
         // ------------------------------------
 
         // Call user game init function.
+        mem_tag_push(MEM_TAG_GAME);
         game.init();
+        mem_tag_pop();
         engine()->game.is_running = true;
+
+        if (game.flags.use_sim_thread) {
+            if (game.flags.is_headless) {
+                log_warning("Headless runs have no render thread, updating on the main thread.\n");
+            } else {
+                engine()->sim = sim_create(game.snapshot_size);
+            }
+        }
     }
 
     return engine();
 }
 
+// Runs this frame's share of update(): whole fixed ticks out of the banked time, or a single
+// variable step. Returns false once the game has stopped.
+bool engine_simulate(Time *time, bool is_threaded) {
+    if (time->tick > 0) {
+        // Fixed timestep: bank last frame's wall time and consume it in whole ticks, so the
+        // simulation advances at the same rate no matter how fast we render.
+        time->accumulator += time->step;
+        time->ticks = 0;
+        while (time->accumulator >= time->tick &&
+               time->ticks < engine()->game.max_ticks_per_frame) {
+            PROFILE_BEGIN("update");
+            mem_tag_push(MEM_TAG_GAME);
+            engine()->game.update();
+            mem_tag_pop();
+            PROFILE_END();
+            // The window belongs to the render thread, the sim thread only checks the flag.
+            if (is_threaded ? !__atomic_load_n(&engine()->game.is_running, __ATOMIC_ACQUIRE)
+                            : !game_is_running()) {
+                return false;
+            }
+            time->accumulator -= time->tick;
+            time->ticks++;
+        }
+
+        // Too far behind to catch up, drop the backlog instead of spiralling.
+        if (time->accumulator >= time->tick) {
+            time->accumulator %= time->tick;
+        }
+        if (!is_threaded) {
+            time->alpha = (float64)time->accumulator / time->tick;
+        }
+    } else {
+        PROFILE_BEGIN("update");
+        mem_tag_push(MEM_TAG_GAME);
+        engine()->game.update();
+        mem_tag_pop();
+        PROFILE_END();
+        if (is_threaded ? !__atomic_load_n(&engine()->game.is_running, __ATOMIC_ACQUIRE)
+                        : !game_is_running()) {
+            return false;
+        }
+        time->ticks = 1;
+        if (!is_threaded) {
+            time->alpha = 1.0;
+        }
+    }
+    return true;
+}
+
 void engine_frame(void) {
     Platform *platform = engine()->platform;
+    SimThread *sim = engine()->sim;
+    PROFILE_BEGIN("frame");
 
-    platform->time.current = time_elapsed();
-    platform->time.update = platform->time.current - platform->time.previous;
-    platform->time.previous = platform->time.current;
+    // previous holds the start of this frame, current the latest reading.
+    platform->time.previous = time_elapsed();
+    platform->time.current = platform->time.previous;
 
-    platform_update(platform);
+    PROFILE_BEGIN("platform_update");
+    if (sim != NULL) {
+        platform_poll_events(platform);
+    } else {
+        platform_update(platform);
+    }
+    PROFILE_END();
     if (!game_is_running()) {
         engine()->shutdown();
         return;
     }
 
-    engine()->game.update();
-    if (!game_is_running()) {
-        engine()->shutdown();
-        return;
+    uint64 update_end;
+    if (sim != NULL) {
+        // update() runs on the sim thread, just take the newest snapshot it has published.
+        sim_acquire(sim);
+        platform->time.alpha = sim_alpha(sim);
+        update_end = time_elapsed();
+    } else {
+        if (!engine_simulate(&platform->time, false)) {
+            engine()->shutdown();
+            return;
+        }
+        update_end = time_elapsed();
+        platform->time.update = update_end - platform->time.current;
     }
 
-    engine()->game.draw();
+    // Headless frames have nothing to draw into, the whole frame goes to update().
+    if (engine()->graphics != NULL) {
+        PROFILE_BEGIN("draw");
+        graphics_pass_begin("draw");
+        mem_tag_push(MEM_TAG_GAME);
+        engine()->game.draw();
+        mem_tag_pop();
+        graphics_pass_end();
+        graphics_render();
+        PROFILE_END();
+    }
     if (!game_is_running()) {
         engine()->shutdown();
         return;
     }
 
+    if (engine()->graphics != NULL) {
+        PROFILE_BEGIN("swap");
 #ifdef PLATFORM_WINDOWS
 #else
-    glfwSwapBuffers(platform->window.handle);
+        glfwSwapBuffers(platform->window.handle);
 #endif
+        PROFILE_END();
+
+        gpu_timer_frame(&engine()->graphics->timer);
+        platform->time.gpu = engine()->graphics->timer.total;
+        graphics_hot_reload();
+    }
 
     platform->time.current = time_elapsed();
-    platform->time.render = platform->time.current - platform->time.previous;
-    platform->time.previous = platform->time.current;
-    platform->time.frame = platform->time.update + platform->time.render;
-    platform->time.delta = platform->time.frame / 1000.0;
-
-    float target = 1000.0 / platform->time.fps_limit;
-    if (platform->time.frame < target) {
-        engine_sleep((float)(target - platform->time.frame));
-        platform->time.current = time_elapsed();
-        float64 wait_time = platform->time.current - platform->time.previous;
-        platform->time.previous = platform->time.current;
-        platform->time.frame += wait_time;
-        platform->time.delta = platform->time.frame / 1000.0;
+    platform->time.render = platform->time.current - update_end;
+
+    PROFILE_BEGIN("pace");
+    pacer_wait(&platform->pacer);
+    PROFILE_END();
+    platform->time.current = time_elapsed();
+    platform->time.frame = platform->time.current - platform->time.previous;
+    // With a sim thread the simulation keeps its own step.
+    if (sim == NULL) {
+        platform->time.step = platform->time.is_virtual ? platform->time.virtual_step
+                                                        : platform->time.frame;
+        platform->time.delta = platform->time.step / 1000000000.0;
     }
+
+    stats_record(&platform->stats, &platform->time);
+    mem_stats_frame(&platform->memory);
+    arena_frame_reset();
+    PROFILE_END();
 }
 
-void engine_sleep(float ms) {
-#ifdef PLATFORM_WINDOWS
-    Sleep((unsigned int)ms);
-#endif
-#ifdef PLATFORM_OSX
-    usleep(ms * 1000.0f);
-#endif
-#ifdef PLATFORM_LINUX
-    struct timespec req = {0};
-    time_t sec = (int)(ms / 1000.0f);
-    ms -= (sec * 1000);
-    req.tv_sec = sec;
-    req.tv_nsec = ms * 1000000L;
-    while (nanosleep(&req, &req) == -1) {
-        continue;
+// The Time the calling thread's code runs on: the sim thread's own clock when update() calls it
+// from there, the platform's everywhere else.
+Time *engine_time(void) {
+    return engine_time_local != NULL ? engine_time_local : &engine()->platform->time;
+}
+
+// The snapshot draw() should render from when update() runs on the sim thread, NULL otherwise
+// or until the first one has been published.
+const void *engine_snapshot(void) {
+    SimThread *sim = engine()->sim;
+    if (sim == NULL || sim->published[sim->read] == 0) {
+        return NULL;
     }
-#endif
+    return sim->slots[sim->read];
+}
+
+// Stops the engine after the current frame, for games and headless runs that end on their own.
+void engine_quit(void) {
+    __atomic_store_n(&engine()->game.is_running, false, __ATOMIC_RELEASE);
+}
+
+void engine_sleep(float64 ms) {
+    Pacer *pacer = &engine()->platform->pacer;
+    pacer_sleep_until(pacer, (int64)time_now() + (int64)(ms * 1000000.0));
+}
+
+// Starts reading a whole asset without waiting for it, from the pack when the game has one and it
+// has `name`, from the file at `name` otherwise. Returns false if there's no such asset. Check on
+// it with asset_is_loaded() and collect the bytes with asset_finish().
+bool asset_load_async(AssetRequest *request, const char *name) {
+    *request = (AssetRequest){.name = name};
+    pack assets = engine()->assets;
+    const PackEntry *entry = assets != NULL ? pack_find(assets, name) : NULL;
+
+    if (entry != NULL) {
+        uint64 pack_size = file_get_size(assets->f);
+        if (entry->offset > pack_size || entry->size > pack_size - entry->offset ||
+            (entry->compression == PACK_COMPRESSION_NONE && entry->size != entry->raw_size)) {
+            log_error("Asset %s in pack %s is damaged.\n", name, assets->path);
+            return false;
+        }
+        if (entry->compression != PACK_COMPRESSION_NONE &&
+            entry->compression != PACK_COMPRESSION_LZ4) {
+            log_error("Asset %s in pack %s uses unknown compression %u.\n", name, assets->path,
+                      entry->compression);
+            return false;
+        }
+
+        // Stored entries land straight in the result, compressed ones are unpacked once read.
+        request->size = entry->raw_size;
+        request->data = entry->raw_size < (usize)-1 ? malloc(entry->raw_size + 1) : NULL;
+        if (entry->compression == PACK_COMPRESSION_LZ4) {
+            request->block = malloc(entry->size);
+        }
+        if (request->data == NULL ||
+            (entry->compression == PACK_COMPRESSION_LZ4 && request->block == NULL)) {
+            log_error("Unable to allocate %llu bytes for asset %s in pack %s.\n",
+                      (unsigned long long)entry->raw_size, name, assets->path);
+            free(request->data);
+            free(request->block);
+            request->data = request->block = NULL;
+            return false;
+        }
+        request->io = (IoRequest){.file = assets->f,
+                                  .offset = entry->offset,
+                                  .size = entry->size,
+                                  .data = request->block != NULL ? request->block
+                                                                 : request->data};
+    } else {
+        if (!file_exists(name)) {
+            log_error("Trying to load asset %s that doesn't exist.\n", name);
+            return false;
+        }
+        request->file = file_open(name, FILE_MODE_READ_BINARY);
+        request->size = file_get_size(request->file);
+        request->data = request->size < (usize)-1 ? malloc(request->size + 1) : NULL;
+        if (request->data == NULL) {
+            log_error("Unable to allocate %llu bytes for asset %s.\n",
+                      (unsigned long long)request->size, name);
+            file_close(request->file);
+            request->file = NULL;
+            return false;
+        }
+        request->io =
+            (IoRequest){.file = request->file, .size = request->size, .data = request->data};
+    }
+
+    io_read(&request->io);
+    return true;
+}
+
+bool asset_is_loaded(AssetRequest *request) {
+    return io_poll(&request->io) != IO_PENDING;
+}
+
+// Waits for the read if it's still going and hands over the bytes, null terminated and free()d by
+// the caller. NULL if the read failed or the asset is damaged.
+void *asset_finish(AssetRequest *request, uint64 *size) {
+    bool is_read = io_wait(&request->io) == IO_DONE && request->io.bytes == request->io.size;
+    if (request->file != NULL) {
+        file_close(request->file);
+        request->file = NULL;
+    }
+    if (is_read && request->block != NULL) {
+        is_read = pack_decompress(request->block, request->io.size, request->data,
+                                  request->size) == request->size;
+    }
+    free(request->block);
+    request->block = NULL;
+
+    uint8 *data = request->data;
+    request->data = NULL;
+    if (!is_read) {
+        log_error("Unable to load asset %s.\n", request->name);
+        free(data);
+        return NULL;
+    }
+    data[request->size] = '\0';
+    if (size != NULL) {
+        *size = request->size;
+    }
+    return data;
+}
+
+// Reads a whole asset the way asset_load_async() does and waits for it. The bytes are null
+// terminated and free()d by the caller, NULL if not found.
+void *asset_load(const char *name, uint64 *size) {
+    AssetRequest request;
+    if (!asset_load_async(&request, name)) {
+        return NULL;
+    }
+    return asset_finish(&request, size);
 }
 
 void engine_destroy(void) {
+    // Stop the sim thread before the game tears down anything update() might still be using.
+    engine_quit();
+    sim_destroy(engine()->sim);
+    engine()->sim = NULL;
     engine()->game.shutdown();
-    engine()->game.is_running = false;
+    // Workers record profiler zones, so they have to be gone before the trace is written.
+    jobs_destroy(engine()->jobs);
+    io_destroy(engine()->io);
+    shader_use_pack(NULL);
+    pack_close(engine()->assets);
+    pool_destroy(&engine()->entities);
+
+    pacer_log_stats(&engine()->platform->pacer);
+    stats_log(&engine()->platform->stats);
+    if (engine()->game.stats_path != NULL) {
+        stats_dump_csv(&engine()->platform->stats, engine()->game.stats_path);
+    }
+    stats_destroy(&engine()->platform->stats);
+    mem_stats_log(&engine()->platform->memory);
+    mem_stats_destroy(&engine()->platform->memory);
+    journal_close(&engine()->platform->journal);
+#ifdef PROFILER
+    if (engine()->game.trace_path != NULL) {
+        profiler_dump(engine()->game.trace_path);
+    }
+    profiler_destroy();
+#endif
 
     graphics_destroy(engine()->graphics);
     audio_destroy(engine()->audio);
     platform_destroy(engine()->platform);
+    arena_thread_release();
 }
 
 /*
@@ -384,7 +1282,18 @@ WHICH INCLUDES VARIOUS ENGINE SUBMODULES FROM OTHER FILES
 */
 
 #include "platform.h"
+#include "pacer.h"
+#include "stats.h"
+#include "mem_stats.h"
+#include "profiler.h"
+#include "journal.h"
+#include "jobs.h"
+#include "io.h"
+#include "sim.h"
+#include "entity.h"
 #include "windows.h"
+#include "gpu_timer.h"
+#include "mesh.h"
 #include "graphics.h"
 #include "audio.h"
 
@@ -2,33 +2,84 @@
 #include <stdio.h>
 #include <string.h>
 #define NO_MEMORY_DEBUG
+#undef MEMORY_DEBUG
 #include "core.h"
 
 extern void debug_mem_print(uint min_allocs);
 
 #define MEMORY_OVER_ALLOC 32
 #define MEMORY_MAGIC_NUMBER 132
+#define MEMORY_TAG_DEPTH 16
+#define MEMORY_TOMBSTONE ((void *)1) /* marks a freed slot in the pointer table */
+
+/* Tags are tracked with or without MEMORY_DEBUG. */
+
+const char *mem_tag_names[MEM_TAG_COUNT] = {"general", "platform", "graphics", "audio",
+                                            "assets",  "game",     "ui"};
+
+static thread_local uint8 mem_tag_stack[MEMORY_TAG_DEPTH];
+static thread_local uint mem_tag_depth = 0;
+
+void mem_tag_push(MemTag tag) {
+    if (mem_tag_depth < MEMORY_TAG_DEPTH) {
+        mem_tag_stack[mem_tag_depth] = (uint8)tag;
+    }
+    mem_tag_depth++;
+}
+
+void mem_tag_pop(void) {
+    if (mem_tag_depth > 0) {
+        mem_tag_depth--;
+    }
+}
+
+MemTag mem_tag_current(void) {
+    if (mem_tag_depth == 0) {
+        return MEM_TAG_GENERAL;
+    }
+    uint top = mem_tag_depth < MEMORY_TAG_DEPTH ? mem_tag_depth : MEMORY_TAG_DEPTH;
+    return (MemTag)mem_tag_stack[top - 1];
+}
+
+/* One live allocation, found by hashing its pointer. */
 typedef struct {
-    uint size;
     void *buf;
+    usize size;
+    uint line_id;
+    uint8 tag;
 } STMemAllocBuf;
 
+/* Everything allocated from one file and line, found by hashing the two. */
 typedef struct {
     uint line;
-    char file[256];
-    STMemAllocBuf *allocs;
-    uint alloc_count;
-    uint alloc_alocated;
-    uint size;
+    const char *file;
+    usize size;
+    usize peak;
     uint alocated;
     uint freed;
 } STMemAllocLine;
 
-STMemAllocLine alloc_lines[1024];
+STMemAllocBuf *alloc_table = NULL;
+usize alloc_table_size = 0;  /* slots, always a power of two */
+usize alloc_table_count = 0; /* live allocations */
+usize alloc_table_used = 0;  /* live allocations plus tombstones */
+
+STMemAllocLine *alloc_lines = NULL;
 uint alloc_line_count = 0;
+uint alloc_line_alocated = 0;
+uint *alloc_line_table = NULL; /* index + 1 into alloc_lines, 0 for an empty slot */
+uint alloc_line_table_size = 0;
+
+MemTagStats alloc_tags[MEM_TAG_COUNT];
+uint64 alloc_frame_count = 0;
+uint64 alloc_frame_bytes = 0;
+
 void *alloc_mutex = NULL;
 void (*alloc_mutex_lock)(void *mutex) = NULL;
 void (*alloc_mutex_unlock)(void *mutex) = NULL;
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+static pthread_mutex_t alloc_default_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 void debug_memory_init(void (*lock)(void *mutex), void (*unlock)(void *mutex), void *mutex) {
     alloc_mutex = mutex;
@@ -36,194 +87,291 @@ void debug_memory_init(void (*lock)(void *mutex), void (*unlock)(void *mutex), v
     alloc_mutex_unlock = unlock;
 }
 
-bool debug_memory(void) {
-    bool output = false;
-    uint i, j, k;
-    if (alloc_mutex != NULL)
+static void debug_mem_lock(void) {
+    if (alloc_mutex != NULL) {
         alloc_mutex_lock(alloc_mutex);
-    for (i = 0; i < alloc_line_count; i++) {
-        for (j = 0; j < alloc_lines[i].alloc_count; j++) {
-            uint8 *buf;
-            uint size;
-            buf = alloc_lines[i].allocs[j].buf;
-            size = alloc_lines[i].allocs[j].size;
-            for (k = 0; k < MEMORY_OVER_ALLOC; k++) {
-                if (buf[size + k] != MEMORY_MAGIC_NUMBER) {
-                    break;
-                }
-            }
-            if (k < MEMORY_OVER_ALLOC) {
-                printf("MEM ERROR: Overshoot at line %u in file %s\n", alloc_lines[i].line,
-                       alloc_lines[i].file);
+        return;
+    }
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+    pthread_mutex_lock(&alloc_default_mutex);
+#endif
+}
+
+static void debug_mem_unlock(void) {
+    if (alloc_mutex != NULL) {
+        alloc_mutex_unlock(alloc_mutex);
+        return;
+    }
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+    pthread_mutex_unlock(&alloc_default_mutex);
+#endif
+}
 
-                {
-                    uint *X = NULL;
-                    X[0] = 0;
-                }
+static uint64 debug_mem_hash_pointer(void *pointer) {
+    uint64 x = (uint64)(uintptr_t)pointer;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return x;
+}
 
-                output = true;
-            }
+static uint64 debug_mem_hash_line(const char *file, uint line) {
+    uint64 hash = 14695981039346656037ull;
+    for (; *file != 0; file++) {
+        hash = (hash ^ (uint8)*file) * 1099511628211ull;
+    }
+    return (hash ^ line) * 1099511628211ull;
+}
+
+/* Slot holding `buf`, or NULL. Walks past tombstones, stops at the first empty slot. */
+static STMemAllocBuf *debug_mem_find(void *buf) {
+    if (alloc_table_size == 0 || buf == NULL) {
+        return NULL;
+    }
+    usize mask = alloc_table_size - 1;
+    for (usize i = debug_mem_hash_pointer(buf) & mask;; i = (i + 1) & mask) {
+        if (alloc_table[i].buf == buf) {
+            return &alloc_table[i];
+        }
+        if (alloc_table[i].buf == NULL) {
+            return NULL;
         }
     }
-    if (alloc_mutex != NULL) {
-        alloc_mutex_unlock(alloc_mutex);
+}
+
+static void debug_mem_insert(STMemAllocBuf *alloc) {
+    usize mask = alloc_table_size - 1;
+    usize i = debug_mem_hash_pointer(alloc->buf) & mask;
+    while (alloc_table[i].buf != NULL && alloc_table[i].buf != MEMORY_TOMBSTONE) {
+        i = (i + 1) & mask;
     }
-    return output;
+    if (alloc_table[i].buf == NULL) {
+        alloc_table_used++;
+    }
+    alloc_table[i] = *alloc;
+    alloc_table_count++;
 }
 
-void debug_mem_add(void *pointer, uint size, char *file, uint line) {
-    uint i, j;
-    for (i = 0; i < MEMORY_OVER_ALLOC; i++) {
-        ((uint8 *)pointer)[size + i] = MEMORY_MAGIC_NUMBER;
+/* Keeps the table under 3/4 full counting tombstones, rebuilding it to drop them. */
+static void debug_mem_reserve(void) {
+    if ((alloc_table_used + 1) * 4 < alloc_table_size * 3) {
+        return;
     }
 
-    for (i = 0; i < alloc_line_count; i++) {
-        if (line == alloc_lines[i].line) {
-            for (j = 0; file[j] != 0 && file[j] == alloc_lines[i].file[j]; j++)
-                ;
-            if (file[j] == alloc_lines[i].file[j]) {
-                break;
+    STMemAllocBuf *old = alloc_table;
+    usize old_size = alloc_table_size;
+    usize size = old_size > 0 ? old_size : 4096;
+    while ((alloc_table_count + 1) * 2 > size) {
+        size *= 2;
+    }
+
+    alloc_table = calloc(size, sizeof *alloc_table);
+    alloc_table_size = size;
+    alloc_table_count = alloc_table_used = 0;
+    for (usize i = 0; i < old_size; i++) {
+        if (old[i].buf != NULL && old[i].buf != MEMORY_TOMBSTONE) {
+            debug_mem_insert(&old[i]);
+        }
+    }
+    free(old);
+}
+
+static uint debug_mem_line(const char *file, uint line) {
+    uint i, mask;
+    if (alloc_line_table_size == 0 || (alloc_line_count + 1) * 2 > alloc_line_table_size) {
+        uint size = alloc_line_table_size > 0 ? alloc_line_table_size * 2 : 1024;
+        free(alloc_line_table);
+        alloc_line_table = calloc(size, sizeof *alloc_line_table);
+        alloc_line_table_size = size;
+        mask = size - 1;
+        for (uint j = 0; j < alloc_line_count; j++) {
+            i = debug_mem_hash_line(alloc_lines[j].file, alloc_lines[j].line) & mask;
+            while (alloc_line_table[i] != 0) {
+                i = (i + 1) & mask;
             }
+            alloc_line_table[i] = j + 1;
         }
     }
-    if (i < alloc_line_count) {
-        if (alloc_lines[i].alloc_alocated == alloc_lines[i].alloc_count) {
-            alloc_lines[i].alloc_alocated += 1024;
-            alloc_lines[i].allocs =
-                realloc(alloc_lines[i].allocs,
-                        (sizeof *alloc_lines[i].allocs) * alloc_lines[i].alloc_alocated);
+
+    mask = alloc_line_table_size - 1;
+    for (i = debug_mem_hash_line(file, line) & mask; alloc_line_table[i] != 0; i = (i + 1) & mask) {
+        STMemAllocLine *found = &alloc_lines[alloc_line_table[i] - 1];
+        if (found->line == line && (found->file == file || strcmp(found->file, file) == 0)) {
+            return alloc_line_table[i] - 1;
         }
-        alloc_lines[i].allocs[alloc_lines[i].alloc_count].size = size;
-        alloc_lines[i].allocs[alloc_lines[i].alloc_count++].buf = pointer;
-        alloc_lines[i].size += size;
-        alloc_lines[i].alocated++;
-    } else {
-        if (i < 1024) {
-            alloc_lines[i].line = line;
-            for (j = 0; j < 255 && file[j] != 0; j++) {
-                alloc_lines[i].file[j] = file[j];
-            }
-            alloc_lines[i].file[j] = 0;
-            alloc_lines[i].alloc_alocated = 256;
-            alloc_lines[i].allocs =
-                malloc((sizeof *alloc_lines[i].allocs) * alloc_lines[i].alloc_alocated);
-            alloc_lines[i].allocs[0].size = size;
-            alloc_lines[i].allocs[0].buf = pointer;
-            alloc_lines[i].alloc_count = 1;
-            alloc_lines[i].size = size;
-            alloc_lines[i].freed = 0;
-            alloc_lines[i].alocated++;
-            alloc_line_count++;
+    }
+
+    if (alloc_line_alocated == alloc_line_count) {
+        alloc_line_alocated = alloc_line_alocated > 0 ? alloc_line_alocated * 2 : 256;
+        alloc_lines = realloc(alloc_lines, (sizeof *alloc_lines) * alloc_line_alocated);
+    }
+    /* file is always a __FILE__ literal, it outlives us. */
+    alloc_lines[alloc_line_count] = (STMemAllocLine){.line = line, .file = file};
+    alloc_line_table[i] = alloc_line_count + 1;
+    return alloc_line_count++;
+}
+
+static bool debug_mem_overshot(STMemAllocBuf *alloc) {
+    for (uint k = 0; k < MEMORY_OVER_ALLOC; k++) {
+        if (((uint8 *)alloc->buf)[alloc->size + k] != MEMORY_MAGIC_NUMBER) {
+            return true;
         }
     }
+    return false;
 }
 
-void *debug_mem_malloc(uint size, char *file, uint line) {
-    void *pointer;
-    uint i;
-    if (alloc_mutex != NULL) {
-        alloc_mutex_lock(alloc_mutex);
+bool debug_memory(void) {
+    bool output = false;
+    debug_mem_lock();
+    for (usize i = 0; i < alloc_table_size; i++) {
+        STMemAllocBuf *alloc = &alloc_table[i];
+        if (alloc->buf == NULL || alloc->buf == MEMORY_TOMBSTONE || !debug_mem_overshot(alloc)) {
+            continue;
+        }
+        printf("MEM ERROR: Overshoot at line %u in file %s\n", alloc_lines[alloc->line_id].line,
+               alloc_lines[alloc->line_id].file);
+
+        {
+            uint *X = NULL;
+            X[0] = 0;
+        }
+
+        output = true;
+    }
+    debug_mem_unlock();
+    return output;
+}
+
+void debug_mem_add(void *pointer, usize size, const char *file, uint line) {
+    for (uint i = 0; i < MEMORY_OVER_ALLOC; i++) {
+        ((uint8 *)pointer)[size + i] = MEMORY_MAGIC_NUMBER;
+    }
+
+    STMemAllocBuf alloc = {.buf = pointer,
+                           .size = size,
+                           .line_id = debug_mem_line(file, line),
+                           .tag = (uint8)mem_tag_current()};
+    debug_mem_reserve();
+    debug_mem_insert(&alloc);
+
+    STMemAllocLine *site = &alloc_lines[alloc.line_id];
+    site->size += size;
+    site->alocated++;
+    if (site->size > site->peak) {
+        site->peak = site->size;
+    }
+
+    alloc_frame_count++;
+    alloc_frame_bytes += size;
+
+    MemTagStats *tag = &alloc_tags[alloc.tag];
+    bool was_over = tag->budget > 0 && tag->bytes > tag->budget;
+    tag->bytes += size;
+    tag->allocations++;
+    if (tag->bytes > tag->peak) {
+        tag->peak = tag->bytes;
+    }
+    if (tag->budget > 0 && tag->bytes > tag->budget && !was_over) {
+        printf("MEM WARNING: %s is over its %zu byte budget (%zu bytes) after line %u in file %s\n",
+               mem_tag_names[alloc.tag], tag->budget, tag->bytes, line, file);
     }
+}
+
+bool debug_mem_remove(void *buf) {
+    STMemAllocBuf *alloc = debug_mem_find(buf);
+    if (alloc == NULL) {
+        return false;
+    }
+
+    STMemAllocLine *site = &alloc_lines[alloc->line_id];
+    if (debug_mem_overshot(alloc)) {
+        printf("MEM ERROR: Overshoot at line %u in file %s\n", site->line, site->file);
+    }
+    site->size -= alloc->size;
+    site->freed++;
+    alloc_tags[alloc->tag].bytes -= alloc->size;
+    alloc_tags[alloc->tag].frees++;
+
+    alloc->buf = MEMORY_TOMBSTONE;
+    alloc_table_count--;
+    return true;
+}
+
+void *debug_mem_malloc(usize size, const char *file, uint line) {
+    void *pointer;
+    debug_mem_lock();
     pointer = malloc(size + MEMORY_OVER_ALLOC);
 
     if (pointer == NULL) {
-        printf("MEM ERROR: Malloc returns NULL when trying to allocate %u bytes at line %u in file "
+        printf("MEM ERROR: Malloc returns NULL when trying to allocate %zu bytes at line %u in file "
                "%s\n",
                size, line, file);
-        if (alloc_mutex != NULL)
-            alloc_mutex_unlock(alloc_mutex);
+        debug_mem_unlock();
         debug_mem_print(0);
         exit(0);
     }
-    for (i = 0; i < size + MEMORY_OVER_ALLOC; i++) {
-        ((uint8 *)pointer)[i] = MEMORY_MAGIC_NUMBER + 1;
-    }
+    memset(pointer, MEMORY_MAGIC_NUMBER + 1, size + MEMORY_OVER_ALLOC);
     debug_mem_add(pointer, size, file, line);
-    if (alloc_mutex != NULL) {
-        alloc_mutex_unlock(alloc_mutex);
-    }
+    debug_mem_unlock();
     return pointer;
 }
 
-bool debug_mem_remove(void *buf) {
-    uint i, j, k;
-    for (i = 0; i < alloc_line_count; i++) {
-        for (j = 0; j < alloc_lines[i].alloc_count; j++) {
-            if (alloc_lines[i].allocs[j].buf == buf) {
-                for (k = 0; k < MEMORY_OVER_ALLOC; k++) {
-                    if (((uint8 *)buf)[alloc_lines[i].allocs[j].size + k] != MEMORY_MAGIC_NUMBER) {
-                        break;
-                    }
-                }
-                if (k < MEMORY_OVER_ALLOC) {
-                    printf("MEM ERROR: Overshoot at line %u in file %s\n", alloc_lines[i].line,
-                           alloc_lines[i].file);
-                }
-                alloc_lines[i].size -= alloc_lines[i].allocs[j].size;
-                alloc_lines[i].allocs[j] = alloc_lines[i].allocs[--alloc_lines[i].alloc_count];
-                alloc_lines[i].freed++;
-                return true;
-            }
-        }
+void *debug_mem_calloc(usize count, usize size, const char *file, uint line) {
+    if (size != 0 && count > ((usize)-1 - MEMORY_OVER_ALLOC) / size) {
+        printf("MEM ERROR: Calloc of %zu x %zu bytes overflows at line %u in file %s\n", count,
+               size, line, file);
+        return NULL;
     }
-    return false;
+
+    void *pointer = debug_mem_malloc(count * size, file, line);
+    memset(pointer, 0, count * size);
+    return pointer;
 }
 
 void debug_mem_free(void *buf) {
-    if (alloc_mutex != NULL) {
-        alloc_mutex_lock(alloc_mutex);
+    if (buf == NULL) {
+        return;
     }
+
+    debug_mem_lock();
     if (!debug_mem_remove(buf)) {
-        uint *X = NULL;
-        X[0] = 0;
+        /* Most likely handed out by a library we don't see into, free it anyway and carry on. */
+        printf("MEM ERROR: Freeing pointer %p that was never allocated through the tracker\n", buf);
     }
     free(buf);
-    if (alloc_mutex != NULL) {
-        alloc_mutex_unlock(alloc_mutex);
-    }
+    debug_mem_unlock();
 }
 
-void *debug_mem_realloc(void *pointer, uint size, char *file, uint line) {
-    uint i, j, k, move;
+void *debug_mem_realloc(void *pointer, usize size, const char *file, uint line) {
+    usize move;
     void *pointer2;
+    STMemAllocBuf *alloc;
     if (pointer == NULL) {
         return debug_mem_malloc(size, file, line);
     }
 
-    if (alloc_mutex != NULL) {
-        alloc_mutex_lock(alloc_mutex);
-    }
-    for (i = 0; i < alloc_line_count; i++) {
-        for (j = 0; j < alloc_lines[i].alloc_count; j++) {
-            if (alloc_lines[i].allocs[j].buf == pointer) {
-                break;
-            }
-        }
-        if (j < alloc_lines[i].alloc_count) {
-            break;
-        }
-    }
-    if (i == alloc_line_count) {
+    debug_mem_lock();
+    alloc = debug_mem_find(pointer);
+    if (alloc == NULL) {
         printf("Mem debugger error. Trying to reallocate pointer %p in %s line %u. Pointer has "
                "never been allocated\n",
                pointer, file, line);
-        for (i = 0; i < alloc_line_count; i++) {
-            for (j = 0; j < alloc_lines[i].alloc_count; j++) {
-                uint *buf;
-                buf = alloc_lines[i].allocs[j].buf;
-                for (k = 0; k < alloc_lines[i].allocs[j].size; k++) {
-                    if (&buf[k] == pointer) {
-                        printf("Trying to reallocate pointer %u bytes (out of %u) into allocation "
-                               "made in %s on line %u.\n",
-                               k, alloc_lines[i].allocs[j].size, alloc_lines[i].file,
-                               alloc_lines[i].line);
-                    }
-                }
+        for (usize i = 0; i < alloc_table_size; i++) {
+            uint8 *buf = alloc_table[i].buf;
+            if (buf == NULL || buf == MEMORY_TOMBSTONE) {
+                continue;
+            }
+            if ((uint8 *)pointer > buf && (uint8 *)pointer < buf + alloc_table[i].size) {
+                printf("Trying to reallocate pointer %zu bytes (out of %zu) into allocation "
+                       "made in %s on line %u.\n",
+                       (usize)((uint8 *)pointer - buf), alloc_table[i].size,
+                       alloc_lines[alloc_table[i].line_id].file,
+                       alloc_lines[alloc_table[i].line_id].line);
             }
         }
         exit(0);
     }
-    move = alloc_lines[i].allocs[j].size;
+    move = alloc->size;
 
     if (move > size) {
         move = size;
@@ -231,84 +379,100 @@ void *debug_mem_realloc(void *pointer, uint size, char *file, uint line) {
 
     pointer2 = malloc(size + MEMORY_OVER_ALLOC);
     if (pointer2 == NULL) {
-        printf("MEM ERROR: Realloc returns NULL when trying to allocate %u bytes at line %u in "
+        printf("MEM ERROR: Realloc returns NULL when trying to allocate %zu bytes at line %u in "
                "file %s\n",
                size, line, file);
-        if (alloc_mutex != NULL)
-            alloc_mutex_unlock(alloc_mutex);
+        debug_mem_unlock();
         debug_mem_print(0);
         exit(0);
     }
-    for (i = 0; i < size + MEMORY_OVER_ALLOC; i++) {
-        ((uint8 *)pointer2)[i] = MEMORY_MAGIC_NUMBER + 1;
-    }
+    memset(pointer2, MEMORY_MAGIC_NUMBER + 1, size + MEMORY_OVER_ALLOC);
     memcpy(pointer2, pointer, move);
 
-    debug_mem_add(pointer2, size, file, line);
     debug_mem_remove(pointer);
     free(pointer);
+    debug_mem_add(pointer2, size, file, line);
 
-    if (alloc_mutex != NULL) {
-        alloc_mutex_unlock(alloc_mutex);
-    }
+    debug_mem_unlock();
     return pointer2;
 }
 
+void debug_mem_set_budget(MemTag tag, usize bytes) {
+    debug_mem_lock();
+    alloc_tags[tag].budget = bytes;
+    debug_mem_unlock();
+}
+
+MemTagStats debug_mem_tag_stats(MemTag tag) {
+    debug_mem_lock();
+    MemTagStats stats = alloc_tags[tag];
+    debug_mem_unlock();
+    return stats;
+}
+
+void debug_mem_frame(uint64 *allocations, uint64 *bytes) {
+    debug_mem_lock();
+    *allocations = alloc_frame_count;
+    *bytes = alloc_frame_bytes;
+    alloc_frame_count = alloc_frame_bytes = 0;
+    debug_mem_unlock();
+}
+
 void debug_mem_print(uint min_allocs) {
     uint i;
-    if (alloc_mutex != NULL) {
-        alloc_mutex_lock(alloc_mutex);
-    }
+    debug_mem_lock();
     printf("Memory report:\n----------------------------------------------\n");
     for (i = 0; i < alloc_line_count; i++) {
         if (min_allocs < alloc_lines[i].alocated) {
             printf("%s line: %u\n", alloc_lines[i].file, alloc_lines[i].line);
-            printf(" - Bytes allocated: %u\n - Allocations: %u\n - Frees: %u\n\n",
-                   alloc_lines[i].size, alloc_lines[i].alocated, alloc_lines[i].freed);
+            printf(" - Bytes allocated: %zu (peak %zu)\n - Allocations: %u\n - Frees: %u\n\n",
+                   alloc_lines[i].size, alloc_lines[i].peak, alloc_lines[i].alocated,
+                   alloc_lines[i].freed);
         }
     }
-    printf("----------------------------------------------\n");
-    if (alloc_mutex != NULL) {
-        alloc_mutex_unlock(alloc_mutex);
+    for (i = 0; i < MEM_TAG_COUNT; i++) {
+        MemTagStats *tag = &alloc_tags[i];
+        printf("%-8s %12zu bytes, peak %12zu", mem_tag_names[i], tag->bytes, tag->peak);
+        if (tag->budget > 0) {
+            printf(", budget %12zu%s", tag->budget, tag->peak > tag->budget ? " EXCEEDED" : "");
+        }
+        printf("\n");
     }
+    printf("----------------------------------------------\n");
+    debug_mem_unlock();
 }
 
-uint32 debug_mem_consumption(void) {
-    uint i, sum = 0;
+usize debug_mem_consumption(void) {
+    usize sum = 0;
 
-    if (alloc_mutex != NULL) {
-        alloc_mutex_lock(alloc_mutex);
-    }
-
-    for (i = 0; i < alloc_line_count; i++) {
-        sum += alloc_lines[i].size;
-    }
-
-    if (alloc_mutex != NULL) {
-        alloc_mutex_unlock(alloc_mutex);
+    debug_mem_lock();
+    for (uint i = 0; i < MEM_TAG_COUNT; i++) {
+        sum += alloc_tags[i].bytes;
     }
+    debug_mem_unlock();
 
     return sum;
 }
 
 void debug_mem_reset(void) {
-    uint i;
+    debug_mem_lock();
 
-    if (alloc_mutex != NULL) {
-        alloc_mutex_lock(alloc_mutex);
-    }
-
-    for (i = 0; i < alloc_line_count; i++) {
-        free(alloc_lines[i].allocs);
-    }
+    free(alloc_table);
+    alloc_table = NULL;
+    alloc_table_size = alloc_table_count = alloc_table_used = 0;
+    free(alloc_line_table);
+    alloc_line_table = NULL;
+    alloc_line_table_size = 0;
     alloc_line_count = 0;
-
-    if (alloc_mutex != NULL) {
-        alloc_mutex_unlock(alloc_mutex);
+    for (uint i = 0; i < MEM_TAG_COUNT; i++) {
+        usize budget = alloc_tags[i].budget;
+        alloc_tags[i] = (MemTagStats){.budget = budget};
     }
+
+    debug_mem_unlock();
 }
 
 void exit_crash(uint i) {
     uint *a = NULL;
     a[0] = 0;
-}
\ No newline at end of file
+}
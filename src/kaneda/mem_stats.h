@@ -0,0 +1,136 @@
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+#include "core.h"
+#include "log.h"
+
+#include <stdlib.h>
+
+#if (defined PLATFORM_LINUX)
+#include <fcntl.h>
+#endif
+
+/*
+███╗   ███╗███████╗███╗   ███╗ ██████╗ ██████╗ ██╗   ██╗
+████╗ ████║██╔════╝████╗ ████║██╔═══██╗██╔══██╗╚██╗ ██╔╝
+██╔████╔██║█████╗  ██╔████╔██║██║   ██║██████╔╝ ╚████╔╝
+██║╚██╔╝██║██╔══╝  ██║╚██╔╝██║██║   ██║██╔══██╗  ╚██╔╝
+██║ ╚═╝ ██║███████╗██║ ╚═╝ ██║╚██████╔╝██║  ██║   ██║
+╚═╝     ╚═╝╚══════╝╚═╝     ╚═╝ ╚═════╝ ╚═╝  ╚═╝   ╚═╝
+Samples memory use once per frame: bytes per MemTag and the allocations the frame made come from
+the MEMORY_DEBUG tracker, the resident set size from the OS. Every sample also goes to the profiler
+as counters, so a frame that suddenly allocates lines up with its zones in the trace. Once a game
+is warmed up frame_allocations should sit at 0, anything else is an allocation in the hot path.
+*/
+
+#ifdef MEMORY_DEBUG
+static const char *mem_stats_counter_names[MEM_TAG_COUNT] = {
+    "memory.general", "memory.platform", "memory.graphics", "memory.audio",
+    "memory.assets",  "memory.game",     "memory.ui"};
+#endif
+
+MemStats *mem_stats(void) {
+    return &engine()->platform->memory;
+}
+
+void mem_stats_init(MemStats *stats, usize *budgets) {
+    *stats = (MemStats){.statm = -1};
+#ifdef MEMORY_DEBUG
+    stats->is_tracked = true;
+    for (uint32 i = 0; i < MEM_TAG_COUNT; i++) {
+        if (budgets[i] > 0) {
+            debug_mem_set_budget((MemTag)i, budgets[i]);
+        }
+    }
+#else
+    for (uint32 i = 0; i < MEM_TAG_COUNT; i++) {
+        if (budgets[i] > 0) {
+            log_warning("Memory budgets need MEMORY_DEBUG, the %s budget won't be enforced.\n",
+                        mem_tag_names[i]);
+        }
+    }
+#endif
+#if (defined PLATFORM_LINUX)
+    stats->statm = open("/proc/self/statm", O_RDONLY);
+#endif
+}
+
+static uint64 mem_stats_resident(MemStats *stats) {
+#if (defined PLATFORM_LINUX)
+    char buffer[128];
+    if (stats->statm < 0) {
+        return 0;
+    }
+    ssize_t size = pread(stats->statm, buffer, sizeof(buffer) - 1, 0);
+    if (size <= 0) {
+        return 0;
+    }
+    buffer[size] = '\0';
+
+    // "size resident shared ...", in pages.
+    char *end = NULL;
+    strtoull(buffer, &end, 10);
+    return strtoull(end, NULL, 10) * (uint64)sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+// Call once at the end of every frame, before the frame arena is reset.
+void mem_stats_frame(MemStats *stats) {
+#ifdef MEMORY_DEBUG
+    debug_mem_frame(&stats->frame_allocations, &stats->frame_bytes);
+    for (uint32 i = 0; i < MEM_TAG_COUNT; i++) {
+        stats->tags[i] = debug_mem_tag_stats((MemTag)i);
+        PROFILE_COUNTER(mem_stats_counter_names[i], (float64)stats->tags[i].bytes);
+    }
+    if (stats->frame_allocations > stats->peak_frame_allocations) {
+        stats->peak_frame_allocations = stats->frame_allocations;
+    }
+    if (stats->frame_bytes > stats->peak_frame_bytes) {
+        stats->peak_frame_bytes = stats->frame_bytes;
+    }
+    PROFILE_COUNTER("memory.frame_allocations", (float64)stats->frame_allocations);
+    PROFILE_COUNTER("memory.frame_bytes", (float64)stats->frame_bytes);
+#endif
+
+    stats->frame_arena = arena_frame()->used;
+    stats->resident = mem_stats_resident(stats);
+    if (stats->resident > stats->peak_resident) {
+        stats->peak_resident = stats->resident;
+    }
+    PROFILE_COUNTER("memory.frame_arena", (float64)stats->frame_arena);
+    PROFILE_COUNTER("memory.resident", (float64)stats->resident);
+}
+
+void mem_stats_log(MemStats *stats) {
+    log_info("MEMORY: %.1f MB resident, %.1f MB peak, %.1f MB frame arena peak.\n",
+             stats->resident / 1048576.0, stats->peak_resident / 1048576.0,
+             arena_frame()->peak / 1048576.0);
+    if (!stats->is_tracked) {
+        return;
+    }
+
+    log_info("    > worst frame made %llu allocations, worst frame allocated %llu bytes\n",
+             (unsigned long long)stats->peak_frame_allocations,
+             (unsigned long long)stats->peak_frame_bytes);
+    for (uint32 i = 0; i < MEM_TAG_COUNT; i++) {
+        MemTagStats *tag = &stats->tags[i];
+        if (tag->peak == 0) {
+            continue;
+        }
+        log_info("    > %-8s %10zu bytes  peak %10zu%s\n", mem_tag_names[i], tag->bytes, tag->peak,
+                 tag->budget > 0 && tag->peak > tag->budget ? "  OVER BUDGET" : "");
+    }
+}
+
+void mem_stats_destroy(MemStats *stats) {
+#if (defined PLATFORM_LINUX)
+    if (stats->statm >= 0) {
+        close(stats->statm);
+    }
+#endif
+    stats->statm = -1;
+}
+
+#endif
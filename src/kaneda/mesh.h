@@ -5,30 +5,54 @@
 #include "shader.h"
 #include "stretchy_buffer.h"
 
-typedef struct Vertex {
-    vec3 position;
-    vec3 normal;
-    vec2 tex_coords;
-} Vertex;
-
-typedef struct Texture {
-    uint32 id;
-    const char *type;
-} Texture;
-
-typedef struct Mesh {
-    Vertex *vertices;
-    uint32 *indices;
-    Texture *textures;
-
-    uint32 vao;
-    uint32 vbo;
-    uint32 ebo;
-} Mesh;
-
-Mesh *mesh_create(Vertex *vertices, uint32 *indices, Texture *textures) {
-    Mesh *mesh;
-    mesh = malloc(sizeof(*mesh));
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+███╗   ███╗███████╗███████╗██╗  ██╗
+████╗ ████║██╔════╝██╔════╝██║  ██║
+██╔████╔██║█████╗  ███████╗███████║
+██║╚██╔╝██║██╔══╝  ╚════██║██╔══██║
+██║ ╚═╝ ██║███████╗███████║██║  ██║
+╚═╝     ╚═╝╚══════╝╚══════╝╚═╝  ╚═╝
+Meshes and textures live in the graphics pools and are passed around by handle, so a destroyed
+one is caught as a NULL from mesh_get()/texture_get() instead of a dangling pointer. A mesh only
+refers to its textures, destroying a mesh leaves them alone so they can be shared.
+*/
+
+// Takes over a GL texture `id`, texture_destroy() deletes it.
+TextureHandle texture_create(uint32 id, const char *type) {
+    TextureHandle handle = {pool_alloc(&engine()->graphics->textures)};
+    Texture *texture = texture_get(handle);
+    if (texture == NULL) {
+        return handle;
+    }
+
+    texture->id = id;
+    texture->type = type;
+    return handle;
+}
+
+Texture *texture_get(TextureHandle handle) {
+    return (Texture *)pool_get(&engine()->graphics->textures, handle.id);
+}
+
+void texture_destroy(TextureHandle handle) {
+    Texture *texture = texture_get(handle);
+    if (texture == NULL) {
+        return;
+    }
+    glDeleteTextures(1, &texture->id);
+    pool_free(&engine()->graphics->textures, handle.id);
+}
+
+MeshHandle mesh_create(Vertex *vertices, uint32 *indices, TextureHandle *textures) {
+    MeshHandle handle = {pool_alloc(&engine()->graphics->meshes)};
+    Mesh *mesh = mesh_get(handle);
+    if (mesh == NULL) {
+        return handle;
+    }
+
     mesh->vertices = vertices;
     mesh->indices = indices;
     mesh->textures = textures;
@@ -58,32 +82,59 @@ Mesh *mesh_create(Vertex *vertices, uint32 *indices, Texture *textures) {
                           (void *)offsetof(Vertex, tex_coords));
 
     glBindVertexArray(0);
+    return handle;
+}
+
+Mesh *mesh_get(MeshHandle handle) {
+    return (Mesh *)pool_get(&engine()->graphics->meshes, handle.id);
 }
 
-void mesh_draw(Mesh *mesh, Shader &shader) {
-    uint32 diffuse_number, specular_number = 1;
+static void mesh_release(Mesh *mesh) {
+    glDeleteVertexArrays(1, &mesh->vao);
+    glDeleteBuffers(1, &mesh->vbo);
+    glDeleteBuffers(1, &mesh->ebo);
+}
 
-    for (uint32 i = 0; i < sb_count(mesh->textures); i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        const char *number;
-        const char *name = mesh->textures[i].type;
-        if (strcmp(name, "texture_diffuse") == 0) {
-            sprintf(number, "%u", diffuse_number++);
-        } else if (strcmp(name, "texture_specular") == 0) {
-            sprintf(number, "%u", specular_number++);
+void mesh_destroy(MeshHandle handle) {
+    Mesh *mesh = mesh_get(handle);
+    if (mesh == NULL) {
+        return;
+    }
+    mesh_release(mesh);
+    pool_free(&engine()->graphics->meshes, handle.id);
+}
+
+void mesh_draw(MeshHandle handle, Shader *shader) {
+    Mesh *mesh = mesh_get(handle);
+    if (mesh == NULL) {
+        return;
+    }
+
+    uint32 diffuse_number = 1, specular_number = 1;
+    for (uint32 i = 0; i < (uint32)sb_count(mesh->textures); i++) {
+        Texture *texture = texture_get(mesh->textures[i]);
+        if (texture == NULL) {
+            continue;
+        }
+
+        uint32 number = 0;
+        if (strcmp(texture->type, "texture_diffuse") == 0) {
+            number = diffuse_number++;
+        } else if (strcmp(texture->type, "texture_specular") == 0) {
+            number = specular_number++;
         }
 
-        const char *mat = "material.";
-        strcat(mat, name);
-        strcat(mat, number);
-        shader_set_float(shader, mat, i);
-        glBindTexture(GL_TEXTURE_2D, mesh->textures[i].id);
+        char uniform[64];
+        snprintf(uniform, sizeof(uniform), "material.%s%u", texture->type, number);
+        glActiveTexture(GL_TEXTURE0 + i);
+        shader_set_int(shader, uniform, (int)i);
+        glBindTexture(GL_TEXTURE_2D, texture->id);
     }
     glActiveTexture(GL_TEXTURE0);
 
-    glBindVertexArray(VAO);
+    glBindVertexArray(mesh->vao);
     glDrawElements(GL_TRIANGLES, sb_count(mesh->indices), GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,157 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include "core.h"
+
+#if (defined PLATFORM_LINUX || defined PLATFORM_OSX)
+#include <errno.h>
+#endif
+
+#define PACER_MARGIN_MIN 50000LL     // never wake later than 50us before a deadline
+#define PACER_MARGIN_MAX 4000000LL   // never hand more than 4ms of a frame to the spin loop
+#define PACER_MARGIN_START 1000000LL // 1ms until we have seen how late the scheduler runs
+
+#if (defined __x86_64__ || defined __i386__)
+#define PACER_SPIN_RELAX() __builtin_ia32_pause()
+#else
+#define PACER_SPIN_RELAX()
+#endif
+
+/*
+██████╗  █████╗  ██████╗███████╗██████╗
+██╔══██╗██╔══██╗██╔════╝██╔════╝██╔══██╗
+██████╔╝███████║██║     █████╗  ██████╔╝
+██╔═══╝ ██╔══██║██║     ██╔══╝  ██╔══██╗
+██║     ██║  ██║╚██████╗███████╗██║  ██║
+╚═╝     ╚═╝  ╚═╝ ╚═════╝╚══════╝╚═╝  ╚═╝
+*/
+
+void pacer_init(Pacer *pacer, float64 frame_rate) {
+    *pacer = (Pacer){0};
+    pacer->margin = PACER_MARGIN_START;
+    if (frame_rate > 0.0) {
+        pacer->period = (int64)(1000000000.0 / frame_rate);
+        pacer->deadline = (int64)time_now() + pacer->period;
+    }
+}
+
+// Blocks the OS thread until roughly `target`, without caring about precision.
+static void pacer_os_sleep(int64 target) {
+#ifdef PLATFORM_LINUX
+    struct timespec ts;
+    ts.tv_sec = (time_t)(target / 1000000000LL);
+    ts.tv_nsec = (long)(target % 1000000000LL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        continue;
+    }
+#else
+    int64 remaining = target - (int64)time_now();
+    if (remaining <= 0) {
+        return;
+    }
+#ifdef PLATFORM_WINDOWS
+    Sleep((DWORD)(remaining / 1000000LL));
+#else
+    struct timespec req = {0};
+    req.tv_sec = (time_t)(remaining / 1000000000LL);
+    req.tv_nsec = (long)(remaining % 1000000000LL);
+    while (nanosleep(&req, &req) == -1 && errno == EINTR) {
+        continue;
+    }
+#endif
+#endif
+}
+
+// Sleeps until `margin` before the target, then spins the rest of the way. Each sleep feeds how
+// late the scheduler actually woke us back into the margin, so it settles just above the worst
+// slack we see and the spin stays short.
+void pacer_sleep_until(Pacer *pacer, int64 target) {
+    int64 wake = target - pacer->margin;
+
+    if (wake > (int64)time_now()) {
+        pacer_os_sleep(wake);
+
+        int64 late = (int64)time_now() - wake;
+        if (late < 0) {
+            late = 0;
+        }
+
+        // Track a slowly decaying peak so one good wake-up doesn't shrink the margin right
+        // before a bad one.
+        pacer->slack -= pacer->slack / 64;
+        if (late > pacer->slack) {
+            pacer->slack = late;
+        }
+
+        pacer->margin = pacer->slack + PACER_MARGIN_MIN;
+        if (late > pacer->margin) {
+            // Overslept straight through the deadline, back off hard.
+            pacer->margin = late * 2;
+        }
+        if (pacer->margin > PACER_MARGIN_MAX) {
+            pacer->margin = PACER_MARGIN_MAX;
+        }
+    }
+
+    int64 spin_start = (int64)time_now();
+    int64 now = spin_start;
+    while (now < target) {
+        PACER_SPIN_RELAX();
+        now = (int64)time_now();
+    }
+    pacer->stats.spin = now - spin_start;
+}
+
+// Waits out the rest of the current frame. Deadlines advance by whole periods so rounding never
+// accumulates; a frame that slips by a full period re-anchors instead of rushing the next ones.
+void pacer_wait(Pacer *pacer) {
+    if (pacer->period <= 0) {
+        return;
+    }
+
+    int64 now = (int64)time_now();
+    if (now >= pacer->deadline) {
+        pacer->stats.missed++;
+        pacer->stats.spin = 0;
+    } else {
+        pacer_sleep_until(pacer, pacer->deadline);
+        now = (int64)time_now();
+    }
+
+    int64 overshoot = now - pacer->deadline;
+    pacer->stats.frames++;
+    pacer->stats.last = overshoot;
+    pacer->stats.total += overshoot;
+    if (overshoot > pacer->stats.max) {
+        pacer->stats.max = overshoot;
+    }
+
+    if (overshoot >= pacer->period) {
+        pacer->deadline = now + pacer->period;
+    } else {
+        pacer->deadline += pacer->period;
+    }
+}
+
+// Mean lateness past the deadline over all paced frames, in nanoseconds.
+float64 pacer_mean_overshoot(Pacer *pacer) {
+    if (pacer->stats.frames == 0) {
+        return 0.0;
+    }
+    return (float64)pacer->stats.total / (float64)pacer->stats.frames;
+}
+
+void pacer_log_stats(Pacer *pacer) {
+    if (pacer->period <= 0 || pacer->stats.frames == 0) {
+        return;
+    }
+
+    log_info("PACER: %llu frames at %.3f ms, %llu missed.\n",
+             (unsigned long long)pacer->stats.frames, pacer->period / 1000000.0,
+             (unsigned long long)pacer->stats.missed);
+    log_info("    > Overshoot mean: %.1f us, max: %.1f us\n", pacer_mean_overshoot(pacer) / 1000.0,
+             pacer->stats.max / 1000.0);
+    log_info("    > Sleep margin:   %.1f us\n", pacer->margin / 1000.0);
+}
+
+#endif
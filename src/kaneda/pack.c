@@ -0,0 +1,316 @@
+#include "pack.h"
+#include "log.h"
+
+#define PACK_MIN_MATCH 4
+#define PACK_LAST_LITERALS 5 // the last bytes of a block are always literals
+#define PACK_MATCH_LIMIT 12  // no match may start this close to the end
+#define PACK_HASH_BITS 14
+
+uint64 pack_hash(const char *name, usize size) {
+    uint64 hash = 14695981039346656037ull;
+    for (usize i = 0; i < size; i++) {
+        hash ^= (uint8)name[i];
+        hash *= 1099511628211ull;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+pack pack_open(const char *path) {
+    if (!file_exists(path)) {
+        log_error("Trying to open pack %s that doesn't exist.\n", path);
+        return NULL;
+    }
+
+    pack p = malloc(sizeof(struct pack));
+    *p = (struct pack){.path = path, .f = file_open(path, FILE_MODE_READ_BINARY)};
+    PackHeader *header = &p->header;
+    uint64 size = file_get_size(p->f);
+
+    if (file_read(p->f, 0, sizeof(PackHeader), header) != sizeof(PackHeader) ||
+        header->magic != PACK_MAGIC || header->header_size != sizeof(PackHeader)) {
+        log_error("%s isn't a pack.\n", path);
+        pack_close(p);
+        return NULL;
+    }
+    if (header->version != PACK_VERSION) {
+        log_error("%s is pack version %u, this build reads version %u.\n", path, header->version,
+                  PACK_VERSION);
+        pack_close(p);
+        return NULL;
+    }
+
+    // The table of contents and the names sit back to back, one read gets both.
+    uint64 toc_size = (uint64)header->bucket_count * sizeof(PackEntry);
+    if (header->bucket_count == 0 || (header->bucket_count & (header->bucket_count - 1)) != 0 ||
+        header->names_offset != sizeof(PackHeader) + toc_size ||
+        header->names_offset + header->names_size > size) {
+        log_error("%s has a damaged table of contents.\n", path);
+        pack_close(p);
+        return NULL;
+    }
+
+    uint64 contents_size = toc_size + header->names_size;
+    uint8 *contents = malloc(contents_size);
+    if (file_read(p->f, sizeof(PackHeader), contents_size, contents) != contents_size) {
+        log_error("%s ends in the middle of its table of contents.\n", path);
+        free(contents);
+        pack_close(p);
+        return NULL;
+    }
+    p->entries = (PackEntry *)contents;
+    p->names = (char *)contents + toc_size;
+
+    log_info("Opened pack %s: %u assets, %llu bytes.\n", path, header->entry_count,
+             (unsigned long long)size);
+    return p;
+}
+
+const PackEntry *pack_find(pack p, const char *name) {
+    usize size = strlen(name);
+    uint64 hash = pack_hash(name, size);
+    uint32 mask = p->header.bucket_count - 1;
+
+    for (uint32 i = 0, bucket = (uint32)hash & mask; i <= mask; i++, bucket = (bucket + 1) & mask) {
+        const PackEntry *entry = &p->entries[bucket];
+        if (entry->hash == 0) {
+            return NULL;
+        }
+        if (entry->hash == hash && entry->name_size == size &&
+            (uint64)entry->name_offset + size <= p->header.names_size &&
+            memcmp(p->names + entry->name_offset, name, size) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+uint64 pack_size(pack p, const char *name) {
+    const PackEntry *entry = pack_find(p, name);
+    return entry != NULL ? entry->raw_size : 0;
+}
+
+bool pack_read(pack p, const char *name, void *data) {
+    const PackEntry *entry = pack_find(p, name);
+    if (entry == NULL) {
+        log_error("Pack %s has no asset %s.\n", p->path, name);
+        return false;
+    }
+    if (entry->offset > file_get_size(p->f) || entry->size > file_get_size(p->f) - entry->offset) {
+        log_error("Asset %s runs past the end of pack %s.\n", name, p->path);
+        return false;
+    }
+
+    switch (entry->compression) {
+    case PACK_COMPRESSION_NONE:
+        if (entry->size != entry->raw_size ||
+            file_read(p->f, entry->offset, entry->size, data) != entry->size) {
+            log_error("Unable to read asset %s from pack %s.\n", name, p->path);
+            return false;
+        }
+        return true;
+    case PACK_COMPRESSION_LZ4: {
+        uint8 *block = malloc(entry->size);
+        bool is_read = file_read(p->f, entry->offset, entry->size, block) == entry->size &&
+                       pack_decompress(block, entry->size, data, entry->raw_size) ==
+                           entry->raw_size;
+        free(block);
+        if (!is_read) {
+            log_error("Asset %s in pack %s is damaged.\n", name, p->path);
+        }
+        return is_read;
+    }
+    default:
+        log_error("Asset %s in pack %s uses unknown compression %u.\n", name, p->path,
+                  entry->compression);
+        return false;
+    }
+}
+
+void *pack_load(pack p, const char *name, uint64 *size) {
+    const PackEntry *entry = pack_find(p, name);
+    if (entry == NULL) {
+        log_error("Pack %s has no asset %s.\n", p->path, name);
+        return NULL;
+    }
+
+    uint8 *data = malloc(entry->raw_size + 1);
+    if (!pack_read(p, name, data)) {
+        free(data);
+        return NULL;
+    }
+    data[entry->raw_size] = '\0';
+    if (size != NULL) {
+        *size = entry->raw_size;
+    }
+    return data;
+}
+
+void pack_close(pack p) {
+    if (p == NULL) {
+        return;
+    }
+    file_close(p->f);
+    free(p->entries);
+    free(p);
+}
+
+// LZ4 BLOCKS ------------------------------
+// A block is a run of sequences: a token with the literal count in the high nibble and the match
+// length - 4 in the low one, 255 bytes continuing either count, the literals, then a 2 byte
+// offset back to the match. The last sequence is literals only.
+
+static uint32 pack_read32(const uint8 *p) {
+    uint32 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint8 *pack_write_length(uint8 *op, uint8 *end, usize length) {
+    for (; length >= 255; length -= 255) {
+        if (op >= end) {
+            return NULL;
+        }
+        *op++ = 255;
+    }
+    if (op >= end) {
+        return NULL;
+    }
+    *op++ = (uint8)length;
+    return op;
+}
+
+// Writes literals [anchor, anchor + literals) and, unless it's the last one, the match after them.
+static uint8 *pack_write_sequence(uint8 *op, uint8 *end, const uint8 *anchor, usize literals,
+                                  usize offset, usize match) {
+    if (op >= end) {
+        return NULL;
+    }
+    uint8 *token = op++;
+    *token = (uint8)((literals >= 15 ? 15 : literals) << 4);
+    if (literals >= 15 && (op = pack_write_length(op, end, literals - 15)) == NULL) {
+        return NULL;
+    }
+    if ((usize)(end - op) < literals) {
+        return NULL;
+    }
+    memcpy(op, anchor, literals);
+    op += literals;
+    if (match == 0) {
+        return op;
+    }
+
+    if (end - op < 2) {
+        return NULL;
+    }
+    *op++ = (uint8)offset;
+    *op++ = (uint8)(offset >> 8);
+    match -= PACK_MIN_MATCH;
+    *token |= (uint8)(match >= 15 ? 15 : match);
+    if (match >= 15 && (op = pack_write_length(op, end, match - 15)) == NULL) {
+        return NULL;
+    }
+    return op;
+}
+
+usize pack_compress_bound(usize size) {
+    return size + size / 255 + 16;
+}
+
+usize pack_compress(const uint8 *src, usize size, uint8 *dst, usize capacity) {
+    uint32 *table = calloc(1u << PACK_HASH_BITS, sizeof(uint32));
+    uint8 *op = dst;
+    uint8 *end = dst + capacity;
+    const uint8 *anchor = src;
+
+    // Greedy: take the first 4 byte match the hash table remembers and extend it forwards.
+    usize limit = size > PACK_MATCH_LIMIT ? size - PACK_MATCH_LIMIT : 0;
+    for (usize i = 0; i < limit && op != NULL;) {
+        uint32 sequence = pack_read32(src + i);
+        uint32 slot = (sequence * 2654435761u) >> (32 - PACK_HASH_BITS);
+        usize candidate = table[slot];
+        table[slot] = (uint32)i;
+
+        if (candidate >= i || i - candidate > 65535 || pack_read32(src + candidate) != sequence) {
+            i++;
+            continue;
+        }
+
+        usize match = PACK_MIN_MATCH;
+        while (i + match < size - PACK_LAST_LITERALS && src[candidate + match] == src[i + match]) {
+            match++;
+        }
+        op = pack_write_sequence(op, end, anchor, (usize)(src + i - anchor), i - candidate, match);
+        i += match;
+        anchor = src + i;
+    }
+    if (op != NULL) {
+        op = pack_write_sequence(op, end, anchor, (usize)(src + size - anchor), 0, 0);
+    }
+
+    free(table);
+    return op != NULL ? (usize)(op - dst) : 0;
+}
+
+usize pack_decompress(const uint8 *src, usize size, uint8 *dst, usize capacity) {
+    const uint8 *ip = src;
+    const uint8 *ip_end = src + size;
+    uint8 *op = dst;
+    uint8 *op_end = dst + capacity;
+
+    while (ip < ip_end) {
+        uint8 token = *ip++;
+
+        usize literals = token >> 4;
+        if (literals == 15) {
+            uint8 byte;
+            do {
+                if (ip >= ip_end) {
+                    return 0;
+                }
+                byte = *ip++;
+                literals += byte;
+            } while (byte == 255);
+        }
+        if ((usize)(ip_end - ip) < literals || (usize)(op_end - op) < literals) {
+            return 0;
+        }
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == ip_end) {
+            break;
+        }
+
+        if (ip_end - ip < 2) {
+            return 0;
+        }
+        usize offset = ip[0] | ((usize)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (usize)(op - dst)) {
+            return 0;
+        }
+
+        usize match = (token & 15) + PACK_MIN_MATCH;
+        if ((token & 15) == 15) {
+            uint8 byte;
+            do {
+                if (ip >= ip_end) {
+                    return 0;
+                }
+                byte = *ip++;
+                match += byte;
+            } while (byte == 255);
+        }
+        if ((usize)(op_end - op) < match) {
+            return 0;
+        }
+        // Byte by byte, the match may overlap the bytes it's producing.
+        const uint8 *from = op - offset;
+        for (usize i = 0; i < match; i++) {
+            op[i] = from[i];
+        }
+        op += match;
+    }
+    return (usize)(op - dst);
+}
+// -----------------------------------------
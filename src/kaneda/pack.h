@@ -0,0 +1,140 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include "core.h"
+#include "file.h"
+
+/* A pack is every asset in one file: a header, a table of contents that is an open addressed
+    hash table of the asset names, the names themselves and then the asset bytes, each starting
+    on an `alignment` boundary. Entries are either stored as is or LZ4 block compressed.
+
+    | PackHeader | PackEntry * bucket_count | names | pad | blob | pad | blob | ...
+
+    All fields are little endian. src/tools/pack.c builds packs, `make pack` packs assets/ and
+    shaders/. */
+
+#define PACK_MAGIC 0x4B41504B // "KPAK"
+#define PACK_VERSION 1
+#define PACK_DEFAULT_ALIGNMENT 4096
+
+typedef enum pack_compression {
+    /* The bytes are stored as is. */
+    PACK_COMPRESSION_NONE,
+    /* The bytes are one LZ4 block, without the frame around it. */
+    PACK_COMPRESSION_LZ4,
+} pack_compression;
+
+typedef struct PackHeader {
+    uint32 magic;
+    uint16 version;
+    uint16 header_size; // sizeof(PackHeader), entries start right after it
+    uint32 entry_count;
+    uint32 bucket_count; // power of two, unused buckets have a hash of 0
+    uint32 alignment;
+    uint32 names_size;
+    uint64 names_offset;
+    uint64 data_offset; // first blob
+    uint64 total_size;
+} PackHeader;
+
+typedef struct PackEntry {
+    uint64 hash;   // pack_hash() of the name, never 0
+    uint64 offset; // from the start of the pack
+    uint64 size;   // bytes in the pack
+    uint64 raw_size;
+    uint32 name_offset; // into the names block, names aren't null terminated
+    uint16 name_size;
+    uint16 compression; // pack_compression
+} PackEntry;
+
+typedef struct pack {
+    const char *path;
+    file f;
+    PackHeader header;
+    PackEntry *entries; // bucket_count of them
+    char *names;
+} * pack;
+
+/*
+    Opens a pack and reads its table of contents in one go. Asset bytes are only read on demand
+        \param path The pack file path
+        \return The pack, or NULL if it isn't there or isn't a pack
+*/
+pack pack_open(const char *path);
+
+/*
+    Looks an asset up by the path it was packed from, e.g. "shaders/simple.vert"
+        \param p The pack
+        \param name The asset name
+        \return The entry, or NULL if the pack doesn't have it
+*/
+const PackEntry *pack_find(pack p, const char *name);
+
+/*
+    Gets the unpacked size of an asset
+        \param p The pack
+        \param name The asset name
+        \return The size in bytes, 0 if the pack doesn't have it
+*/
+uint64 pack_size(pack p, const char *name);
+
+/*
+    Reads an asset into a buffer, decompressing it if needed
+        \param p The pack
+        \param name The asset name
+        \param data A preallocated pointer of at least pack_size() bytes
+        \return false if the asset isn't there or is damaged
+*/
+bool pack_read(pack p, const char *name, void *data);
+
+/*
+    Reads an asset into a new allocation, null terminated so text can be used as is
+        \param p The pack
+        \param name The asset name
+        \param size Set to the asset size, can be NULL
+        \return The bytes, free() them when done, or NULL if the asset isn't there
+*/
+void *pack_load(pack p, const char *name, uint64 *size);
+
+/*
+    Closes the pack
+        \param p The pack to close
+*/
+void pack_close(pack p);
+
+/*
+    Hashes an asset name the way the table of contents does
+        \param name The asset name
+        \param size Its length
+        \return The 64 bit FNV-1a hash, never 0
+*/
+uint64 pack_hash(const char *name, usize size);
+
+/*
+    Worst case size of pack_compress() output
+        \param size The input size
+        \return Bytes the destination needs
+*/
+usize pack_compress_bound(usize size);
+
+/*
+    Compresses into a single LZ4 block
+        \param src The bytes to compress
+        \param size The number of bytes
+        \param dst Where the block is written
+        \param capacity Room in dst
+        \return The block size, 0 if it doesn't fit in capacity
+*/
+usize pack_compress(const uint8 *src, usize size, uint8 *dst, usize capacity);
+
+/*
+    Decompresses a single LZ4 block
+        \param src The block
+        \param size The block size
+        \param dst Where the bytes are written
+        \param capacity Room in dst
+        \return The number of bytes written, 0 if the block is damaged or doesn't fit
+*/
+usize pack_decompress(const uint8 *src, usize size, uint8 *dst, usize capacity);
+
+#endif
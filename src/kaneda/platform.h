@@ -4,6 +4,9 @@
 #include "core.h"
 #include "callbacks.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 typedef enum KeyboardKey {
     // Alphanumeric keys
     KEY_APOSTROPHE = 39,
@@ -195,6 +198,10 @@ Platform *platform_create(void) {
 
     assert(platform);
 
+    if (is_headless()) {
+        return platform;
+    }
+
 #ifdef PLATFORM_WINDOWS
 
 #else
@@ -395,16 +402,40 @@ void platform_open_window(const char *title, const uint32 width, const uint32 he
 }
 
 void platform_update(Platform *platform) {
-    input_update(&platform->input);
-    input_process(&platform->input);
+    platform_poll_events(platform);
+    platform_update_input(platform, &platform->time);
+}
+
+// Window thread half of platform_update: talks to the OS and queues whatever input came in.
+void platform_poll_events(Platform *platform) {
+    if (!is_headless()) {
+        input_process(&platform->input);
+    }
     // events_poll();
 }
 
+// Simulation half of platform_update: turns the queued events into this frame's input state.
+// `time` is the clock of the thread running update(), a journal records or replays its step.
+void platform_update_input(Platform *platform, Time *time) {
+    input_update(&platform->input);
+    input_drain(&platform->input);
+    journal_frame(&platform->journal, &platform->input, time);
+    input_latch(&platform->input);
+}
+
 void platform_destroy(Platform *platform) {
     if (platform == NULL) {
         return;
     }
 
+    free(platform->input.events.data);
+    platform->input.events.data = NULL;
+
+    if (is_headless()) {
+        free(platform);
+        return;
+    }
+
 #ifdef PLATFORM_WINDOWS
     ShowCursor(true);
     if (is_fullscreen()) {
@@ -436,6 +467,10 @@ bool is_vsync_on(void) {
     return engine()->game.flags.vsync_on;
 }
 
+bool is_headless(void) {
+    return engine()->game.flags.is_headless;
+}
+
 /*
 ██╗███╗   ██╗██████╗ ██╗   ██╗████████╗
 ██║████╗  ██║██╔══██╗██║   ██║╚══██╔══╝
@@ -446,26 +481,22 @@ bool is_vsync_on(void) {
 */
 
 void input_update(Input *input) {
-    engine()->platform->input.keyboard.num_keys_pressed = 0;
-    engine()->platform->input.keyboard.num_chars_pressed = 0;
+    input->events.count = 0;
+    input->events.read = input->events.key_read = input->events.char_read = 0;
 
-    // Register previous keys states
-    for (int i = 0; i < 512; i++) {
-        engine()->platform->input.keyboard.key_state_previous[i] =
-            engine()->platform->input.keyboard.key_state_current[i];
-    }
-
-    // Register previous mouse states
-    for (int i = 0; i < 3; i++) {
-        engine()->platform->input.mouse.button_state_previous[i] =
-            engine()->platform->input.mouse.button_state_current[i];
-    }
+    // Register previous keys and mouse states
+    memcpy(input->keyboard.key_state_previous, input->keyboard.key_state_current,
+           sizeof(input->keyboard.key_state_current));
+    input->mouse.button_state_previous = input->mouse.button_state_current;
 
     // Register previous mouse wheel state
     engine()->platform->input.mouse.wheel_move_previous =
         engine()->platform->input.mouse.wheel_move_current;
     engine()->platform->input.mouse.wheel_move_current = 0.0f;
+}
 
+void input_process(Input *input) {
+    // GLFW only allows joysticks to be queried from the thread that owns the window.
     for (int i = 0; i < MAX_GAMEPADS; i++) {
 #ifdef PLATFORM_WINDOWS
         XINPUT_STATE state;
@@ -478,9 +509,7 @@ void input_update(Input *input) {
         engine()->platform->input.gamepad.is_ready[i] = glfwJoystickPresent(i) ? true : false;
 #endif
     }
-}
 
-void input_process(Input *input) {
     // Register gamepads buttons events
     for (int i = 0; i < MAX_GAMEPADS; i++) {
         if (engine()->platform->input.gamepad.is_ready[i]) {
@@ -683,6 +712,19 @@ void input_process(Input *input) {
 
             engine()->platform->input.gamepad.num_available_axes = GLFW_GAMEPAD_AXIS_LAST;
 #endif
+
+            // Gamepads are polled rather than called back, so their events come from the edges.
+            for (int k = 0; k < MAX_GAMEPAD_AXES; k++) {
+                char current = input->gamepad.button_state_current[i][k];
+                if (current != input->gamepad.button_state_previous[i][k]) {
+                    input_push_event(&input->queue,
+                                     (InputEvent){.time = time_elapsed(),
+                                                  .type = INPUT_EVENT_GAMEPAD_BUTTON,
+                                                  .device = i,
+                                                  .code = k,
+                                                  .action = current ? GLFW_PRESS : GLFW_RELEASE});
+                }
+            }
         }
     }
 
@@ -693,74 +735,174 @@ void input_process(Input *input) {
 #endif
 }
 
+// Producer side: queues an event for the next drain. Returns false if the consumer has fallen a
+// whole queue behind, which at one drain per frame means something has gone badly wrong.
+bool input_push_event(InputEventQueue *queue, InputEvent event) {
+    uint32 head = queue->head;
+    uint32 tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= INPUT_EVENT_QUEUE_SIZE) {
+        if (queue->dropped++ == 0) {
+            log_warning("Input event queue is full, events are being dropped.\n");
+        }
+        return false;
+    }
+
+    queue->events[head & (INPUT_EVENT_QUEUE_SIZE - 1)] = event;
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Adds an event to this frame's list, growing it as needed so nothing is ever dropped.
+void input_append_event(Input *input, InputEvent *event) {
+    if (input->events.count == input->events.capacity) {
+        input->events.capacity = input->events.capacity ? input->events.capacity * 2 : 64;
+        input->events.data =
+            realloc(input->events.data, input->events.capacity * sizeof(InputEvent));
+    }
+    input->events.data[input->events.count++] = *event;
+}
+
+static void input_apply_event(Input *input, InputEvent *event) {
+    switch (event->type) {
+    case INPUT_EVENT_KEY:
+        input_set_key(input, event->code, event->action != GLFW_RELEASE);
+        break;
+    case INPUT_EVENT_MOUSE_BUTTON:
+        input_mouse_set_button(input, event->code, event->action == GLFW_PRESS);
+        break;
+    case INPUT_EVENT_MOUSE_MOVE:
+        input->mouse.position = event->value;
+        break;
+    case INPUT_EVENT_MOUSE_SCROLL:
+        input->mouse.wheel_move_current += event->value.y;
+        break;
+    case INPUT_EVENT_CURSOR_ENTER:
+        input->mouse.is_cursor_inside_client = event->action ? true : false;
+        break;
+    default:
+        break;
+    }
+}
+
+// Consumer side: moves everything queued so far into this frame's event list and applies it to
+// the key, mouse and cursor state.
+void input_drain(Input *input) {
+    InputEventQueue *queue = &input->queue;
+    uint32 tail = queue->tail;
+    uint32 head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+
+    while (tail != head) {
+        InputEvent *event = &queue->events[tail & (INPUT_EVENT_QUEUE_SIZE - 1)];
+        input_apply_event(input, event);
+        input_append_event(input, event);
+        tail++;
+    }
+    __atomic_store_n(&queue->tail, tail, __ATOMIC_RELEASE);
+}
+
+// Hands out this frame's events one at a time, oldest first. Returns false when there are none
+// left.
+bool input_poll_event(InputEvent *event) {
+    Input *in = input();
+    if (in->events.read >= in->events.count) {
+        return false;
+    }
+    *event = in->events.data[in->events.read++];
+    return true;
+}
+
+// Works out this frame's pressed and released edges, once every source of input has had its say.
+void input_latch(Input *input) {
+    for (int i = 0; i < KEY_BITSET_WORDS; i++) {
+        uint64 current = input->keyboard.key_state_current[i];
+        uint64 previous = input->keyboard.key_state_previous[i];
+        input->keyboard.key_pressed[i] = current & ~previous;
+        input->keyboard.key_released[i] = previous & ~current;
+    }
+
+    input->mouse.button_pressed =
+        input->mouse.button_state_current & ~input->mouse.button_state_previous;
+    input->mouse.button_released =
+        input->mouse.button_state_previous & ~input->mouse.button_state_current;
+}
+
+// Sets or clears a key in the current state, ignoring codes outside the bitset (GLFW_KEY_UNKNOWN)
+void input_set_key(Input *input, int key, bool is_down) {
+    if (key < 0 || key >= MAX_KEYBOARD_KEYS) {
+        return;
+    }
+
+    uint64 bit = 1ULL << (key & 63);
+    if (is_down) {
+        input->keyboard.key_state_current[key >> 6] |= bit;
+    } else {
+        input->keyboard.key_state_current[key >> 6] &= ~bit;
+    }
+}
+
+static inline bool input_key_bit(const uint64 *bits, int key) {
+    if (key < 0 || key >= MAX_KEYBOARD_KEYS) {
+        return false;
+    }
+    return (bits[key >> 6] >> (key & 63)) & 1;
+}
+
 // Detect if a key has been pressed once
 bool input_is_key_pressed(int key) {
-    return (engine()->platform->input.keyboard.key_state_previous[key] == 0) &&
-           (engine()->platform->input.keyboard.key_state_current[key] == 1);
+    return input_key_bit(input()->keyboard.key_pressed, key);
 }
 
 // Detect if a key is being pressed (key held down)
 bool input_is_key_down(int key) {
-    return engine()->platform->input.keyboard.key_state_current[key] == 1;
+    return input_key_bit(input()->keyboard.key_state_current, key);
 }
 
 // Detect if a key has been released once
 bool input_is_key_released(int key) {
-    return (engine()->platform->input.keyboard.key_state_previous[key] == 1) &&
-           (engine()->platform->input.keyboard.key_state_current[key] == 0);
+    return input_key_bit(input()->keyboard.key_released, key);
 }
 
 // Detect if a key is NOT being pressed (key not held down)
 bool input_is_key_up(int key) {
-    return engine()->platform->input.keyboard.key_state_current[key] == 0;
+    return !input_is_key_down(key);
+}
+
+// Fills `keys` with every key that went down or up this frame, lowest code first, and returns how
+// many there were. Costs one word test per 64 keys plus one step per changed key.
+uint32 input_get_changed_keys(int *keys, uint32 max) {
+    uint32 count = 0;
+    for (int i = 0; i < KEY_BITSET_WORDS; i++) {
+        uint64 changed = input()->keyboard.key_pressed[i] | input()->keyboard.key_released[i];
+        while (changed != 0 && count < max) {
+            keys[count++] = i * 64 + __builtin_ctzll(changed);
+            changed &= changed - 1;
+        }
+    }
+    return count;
 }
 
 // Get the last key pressed
 int input_get_last_key_pressed(void) {
-    int value = 0;
-
-    if (engine()->platform->input.keyboard.num_keys_pressed > 0) {
-        // Get character from the queue head
-        value = engine()->platform->input.keyboard.key_pressed_queue[0];
-
-        // Shift elements 1 step toward the head.
-        for (int i = 0; i < (engine()->platform->input.keyboard.num_keys_pressed - 1); i++) {
-            engine()->platform->input.keyboard.key_pressed_queue[i] =
-                engine()->platform->input.keyboard.key_pressed_queue[i + 1];
+    Input *in = input();
+    while (in->events.key_read < in->events.count) {
+        InputEvent *event = &in->events.data[in->events.key_read++];
+        if (event->type == INPUT_EVENT_KEY && event->action == GLFW_RELEASE) {
+            return event->code;
         }
-
-        // Reset last character in the queue
-        engine()
-            ->platform->input.keyboard
-            .key_pressed_queue[engine()->platform->input.keyboard.num_keys_pressed] = 0;
-        engine()->platform->input.keyboard.num_keys_pressed--;
     }
-
-    return value;
+    return 0;
 }
 
 // Get the last char pressed
 int input_get_last_char_pressed(void) {
-    int value = 0;
-
-    if (engine()->platform->input.keyboard.num_chars_pressed > 0) {
-        // Get character from the queue head
-        value = engine()->platform->input.keyboard.char_pressed_queue[0];
-
-        // Shift elements 1 step toward the head.
-        for (int i = 0; i < (engine()->platform->input.keyboard.num_chars_pressed - 1); i++) {
-            engine()->platform->input.keyboard.char_pressed_queue[i] =
-                engine()->platform->input.keyboard.char_pressed_queue[i + 1];
+    Input *in = input();
+    while (in->events.char_read < in->events.count) {
+        InputEvent *event = &in->events.data[in->events.char_read++];
+        if (event->type == INPUT_EVENT_CHAR) {
+            return event->code;
         }
-
-        // Reset last character in the queue
-        engine()
-            ->platform->input.keyboard
-            .char_pressed_queue[engine()->platform->input.keyboard.num_chars_pressed] = 0;
-        engine()->platform->input.keyboard.num_chars_pressed--;
     }
-
-    return value;
+    return 0;
 }
 
 // Return axis movement vector for a gamepad
@@ -818,21 +960,32 @@ int input_gamepad_set_mappings(const char *mappings) {
 #endif
 }
 
+// Sets or clears a mouse button in the current state
+void input_mouse_set_button(Input *input, int button, bool is_down) {
+    if (button < 0 || button >= 8) {
+        return;
+    }
+
+    if (is_down) {
+        input->mouse.button_state_current |= (uint8)(1 << button);
+    } else {
+        input->mouse.button_state_current &= (uint8)~(1 << button);
+    }
+}
+
 // Detect if a mouse button has been pressed once
 bool input_mouse_is_button_pressed(int button) {
-    return (engine()->platform->input.mouse.button_state_current[button] == 1) &&
-           (engine()->platform->input.mouse.button_state_previous[button] == 0);
+    return button >= 0 && button < 8 && ((input()->mouse.button_pressed >> button) & 1);
 }
 
 // Detect if a mouse button is being pressed
 bool input_mouse_is_button_down(int button) {
-    return engine()->platform->input.mouse.button_state_current[button] == 1;
+    return button >= 0 && button < 8 && ((input()->mouse.button_state_current >> button) & 1);
 }
 
 // Detect if a mouse button has been released once
 bool input_mouse_is_button_released(int button) {
-    return (engine()->platform->input.mouse.button_state_current[button] == 0) &&
-           (engine()->platform->input.mouse.button_state_previous[button] == 1);
+    return button >= 0 && button < 8 && ((input()->mouse.button_released >> button) & 1);
 }
 
 // Detect if a mouse button is NOT being pressed
@@ -909,45 +1062,68 @@ void input_mouse_set_cursor(int cursor) {
    ╚═╝   ╚═╝╚═╝     ╚═╝╚══════╝
 */
 
-float64 time_elapsed(void) {
+// Raw monotonic clock in nanoseconds. Only meaningful relative to other readings, but it is the
+// same clock clock_nanosleep() sleeps against.
+uint64 time_now(void) {
 #ifdef PLATFORM_WINDOWS
-    INT64 current_time;
-    QueryPerformanceCounter((LARGE_INTEGER *)&current_time);
-    return current_time;
+    static LARGE_INTEGER frequency = {0};
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    // Split the conversion so counter * 1e9 can't overflow on long uptimes.
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (uint64)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
 #else
-    return glfwGetTime() * 1000.0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec * 1000000000ULL + (uint64)ts.tv_nsec;
 #endif
 }
 
-float64 time_get_fps(void) {
-#define FPS_CAPTURE_FRAMES_COUNT 30   // 30 captures
-#define FPS_AVERAGE_TIME_SECONDS 0.5f // 500 millisecondes
-#define FPS_STEP (FPS_AVERAGE_TIME_SECONDS / FPS_CAPTURE_FRAMES_COUNT)
-    static int index = 0;
-    static float64 history[FPS_CAPTURE_FRAMES_COUNT] = {0};
-    static float64 average = 0, last = 0;
-
-    float64 fps_frame = engine()->platform->time.frame;
+// Nanoseconds since the engine was created.
+uint64 time_elapsed(void) {
+    return time_now() - engine()->platform->time.start;
+}
 
-    if (fps_frame == 0) {
+// Frames per second over the last FPS_CAPTURE_FRAMES_COUNT frames. For anything beyond a counter
+// on screen, look at time_get_summary() instead, the mean hides every stutter.
+float64 time_get_fps(void) {
+#define FPS_CAPTURE_FRAMES_COUNT 30 // 30 captures
+    float64 mean =
+        stats_recent_mean(&engine()->platform->stats, FRAME_STAT_FRAME, FPS_CAPTURE_FRAMES_COUNT);
+    if (mean <= 0.0) {
         return 0;
     }
+    return round(1000000000.0 / mean);
+}
 
-    float64 time = time_elapsed() / 1000.0;
-
-    if ((time - last) > FPS_STEP) {
-        last = (float)time;
-        index = (index + 1) % FPS_CAPTURE_FRAMES_COUNT;
-        average -= history[index];
-        history[index] = fps_frame / FPS_CAPTURE_FRAMES_COUNT;
-        average += history[index];
-    }
+// Min/max/mean and tail percentiles of one frame measurement over the stats history, in ns.
+FrameSummary time_get_summary(FrameStat stat) {
+    return stats_summary(&engine()->platform->stats, stat);
+}
 
-    return round(1.0 / average);
+// Frames that took more than twice the frame budget since the engine started.
+uint64 time_get_hitches(void) {
+    return engine()->platform->stats.hitches;
 }
 
+// Returns the step update() should advance by: the fixed tick when one is set, otherwise the
+// length of the last frame.
 float64 time_delta(void) {
-    return engine()->platform->time.delta;
+    Time *time = engine_time();
+    if (time->tick > 0) {
+        return time->tick / 1000000000.0;
+    }
+    return time->delta;
+}
+
+// Returns the interpolation factor between the previous and current simulation state, for use in
+// draw(). Always 1 when running without a fixed tick.
+float64 time_alpha(void) {
+    return engine()->platform->time.alpha;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "core.h"
+#include "log.h"
+
+bool pool_create(Pool *pool, const char *name, uint32 item_size, uint32 capacity) {
+    *pool = (Pool){.name = name};
+    if (capacity == 0 || capacity > POOL_INDEX_MASK) {
+        log_error("Pool %s can't hold %u items, the most a handle can index is %u.\n", name,
+                  capacity, POOL_INDEX_MASK);
+        return false;
+    }
+
+    pool->item_size = (item_size + 15) & ~15u;
+    pool->capacity = capacity;
+    pool->data = calloc(capacity, pool->item_size);
+    pool->generations = malloc(sizeof(uint16) * capacity);
+    pool->sparse = malloc(sizeof(uint32) * capacity);
+    pool->dense = malloc(sizeof(uint32) * capacity);
+    if (pool->data == NULL || pool->generations == NULL || pool->sparse == NULL ||
+        pool->dense == NULL) {
+        log_fatal("Unable to allocate pool %s (%u x %u bytes).\n", name, capacity,
+                  pool->item_size);
+        pool_destroy(pool);
+        return false;
+    }
+
+    // Thread every slot onto the free list in order, so the first allocations sit together.
+    for (uint32 i = 0; i < capacity; i++) {
+        pool->generations[i] = 1;
+        pool->sparse[i] = i + 1;
+    }
+    pool->free_head = 0;
+    return true;
+}
+
+void pool_destroy(Pool *pool) {
+    free(pool->data);
+    free(pool->generations);
+    free(pool->sparse);
+    free(pool->dense);
+    *pool = (Pool){.name = pool->name};
+}
+
+uint32 pool_alloc(Pool *pool) {
+    if (pool->free_head >= pool->capacity) {
+        log_error("Pool %s is full (%u items).\n", pool->name, pool->capacity);
+        return POOL_HANDLE_NULL;
+    }
+
+    uint32 index = pool->free_head;
+    pool->free_head = pool->sparse[index];
+    pool->sparse[index] = pool->count;
+    pool->dense[pool->count++] = index;
+
+    memset(pool->data + (usize)index * pool->item_size, 0, pool->item_size);
+    return ((uint32)pool->generations[index] << POOL_INDEX_BITS) | index;
+}
+
+bool pool_free(Pool *pool, uint32 handle) {
+    if (pool_get(pool, handle) == NULL) {
+        return false;
+    }
+
+    // Fill the hole in dense with the last live slot.
+    uint32 index = pool_handle_index(handle);
+    uint32 position = pool->sparse[index];
+    uint32 last = pool->dense[--pool->count];
+    pool->dense[position] = last;
+    pool->sparse[last] = position;
+
+    uint16 generation = (pool->generations[index] + 1) & POOL_GENERATION_MASK;
+    pool->generations[index] = generation == 0 ? 1 : generation;
+    pool->sparse[index] = pool->free_head;
+    pool->free_head = index;
+    return true;
+}
@@ -0,0 +1,187 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "core.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+██████╗ ██████╗  ██████╗ ███████╗██╗██╗     ███████╗██████╗
+██╔══██╗██╔══██╗██╔═══██╗██╔════╝██║██║     ██╔════╝██╔══██╗
+██████╔╝██████╔╝██║   ██║█████╗  ██║██║     █████╗  ██████╔╝
+██╔═══╝ ██╔══██╗██║   ██║██╔══╝  ██║██║     ██╔══╝  ██╔══██╗
+██║     ██║  ██║╚██████╔╝██║     ██║███████╗███████╗██║  ██║
+╚═╝     ╚═╝  ╚═╝ ╚═════╝ ╚═╝     ╚═╝╚══════╝╚══════╝╚═╝  ╚═╝
+Zones are recorded into a ring per thread, so the hot path never takes a lock. Each thread claims
+its ring the first time it opens a zone. Only the newest PROFILER_RING_SIZE zones of each thread
+survive, which is what you want when looking at the last few seconds before a hitch. Counters work
+the same way with their own ring and show up in the trace as graphs above the zones.
+*/
+
+static struct {
+    ProfileThread *threads[PROFILER_MAX_THREADS];
+    uint32 thread_count;
+} profiler_data;
+
+static thread_local ProfileThread *profiler_local = NULL;
+
+static ProfileThread *profiler_thread(void) {
+    if (profiler_local != NULL) {
+        return profiler_local;
+    }
+
+    uint32 id = __sync_fetch_and_add(&profiler_data.thread_count, 1);
+    if (id >= PROFILER_MAX_THREADS) {
+        return NULL;
+    }
+
+    ProfileThread *thread = kamalloc_init(ProfileThread);
+    thread->id = id;
+    profiler_data.threads[id] = thread;
+    profiler_local = thread;
+    return thread;
+}
+
+void profiler_begin(const char *name) {
+    ProfileThread *thread = profiler_thread();
+    if (thread == NULL) {
+        return;
+    }
+
+    // Zones nested deeper than the stack are still counted so the matching end stays balanced.
+    if (thread->depth < PROFILER_MAX_DEPTH) {
+        thread->stack[thread->depth].name = name;
+        thread->stack[thread->depth].begin = time_now();
+    }
+    thread->depth++;
+}
+
+void profiler_end(void) {
+    ProfileThread *thread = profiler_local;
+    if (thread == NULL || thread->depth == 0) {
+        return;
+    }
+
+    uint64 end = time_now();
+    thread->depth--;
+    if (thread->depth >= PROFILER_MAX_DEPTH) {
+        return;
+    }
+
+    ProfileZone *zone = &thread->zones[thread->head & (PROFILER_RING_SIZE - 1)];
+    zone->name = thread->stack[thread->depth].name;
+    zone->begin = thread->stack[thread->depth].begin;
+    zone->end = end;
+    zone->depth = thread->depth;
+    thread->head++;
+}
+
+// Samples a value over time, e.g. bytes in use. Each name becomes its own graph in the trace.
+void profiler_counter(const char *name, float64 value) {
+    ProfileThread *thread = profiler_thread();
+    if (thread == NULL) {
+        return;
+    }
+
+    ProfileCounter *counter =
+        &thread->counters[thread->counter_head & (PROFILER_COUNTER_RING_SIZE - 1)];
+    counter->name = name;
+    counter->time = time_now();
+    counter->value = value;
+    thread->counter_head++;
+}
+
+// Writes every zone and counter sample still held in the rings as Chrome trace_event JSON (chrome://tracing or
+// ui.perfetto.dev). Other threads should be quiet while this runs.
+bool profiler_dump(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        log_error("Unable to open %s to write the profiler trace.\n", path);
+        return false;
+    }
+
+    uint32 thread_count = profiler_data.thread_count;
+    if (thread_count > PROFILER_MAX_THREADS) {
+        thread_count = PROFILER_MAX_THREADS;
+    }
+
+    // Trace timestamps start at the oldest zone still held in any ring.
+    uint64 origin = UINT64_MAX;
+    for (uint32 i = 0; i < thread_count; i++) {
+        ProfileThread *thread = profiler_data.threads[i];
+        if (thread == NULL) {
+            continue;
+        }
+        uint64 count = thread->head < PROFILER_RING_SIZE ? thread->head : PROFILER_RING_SIZE;
+        for (uint64 n = thread->head - count; n < thread->head; n++) {
+            uint64 begin = thread->zones[n & (PROFILER_RING_SIZE - 1)].begin;
+            if (begin < origin) {
+                origin = begin;
+            }
+        }
+        count = thread->counter_head < PROFILER_COUNTER_RING_SIZE ? thread->counter_head
+                                                                  : PROFILER_COUNTER_RING_SIZE;
+        if (count > 0) {
+            uint64 n = thread->counter_head - count;
+            uint64 time = thread->counters[n & (PROFILER_COUNTER_RING_SIZE - 1)].time;
+            if (time < origin) {
+                origin = time;
+            }
+        }
+    }
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (uint32 i = 0; i < thread_count; i++) {
+        ProfileThread *thread = profiler_data.threads[i];
+        if (thread == NULL) {
+            continue;
+        }
+
+        uint64 count = thread->head < PROFILER_RING_SIZE ? thread->head : PROFILER_RING_SIZE;
+        for (uint64 n = thread->head - count; n < thread->head; n++) {
+            ProfileZone *zone = &thread->zones[n & (PROFILER_RING_SIZE - 1)];
+            fprintf(fp,
+                    "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", zone->name, thread->id,
+                    (zone->begin - origin) / 1000.0,
+                    (zone->end - zone->begin) / 1000.0);
+            first = false;
+        }
+
+        count = thread->counter_head < PROFILER_COUNTER_RING_SIZE ? thread->counter_head
+                                                                  : PROFILER_COUNTER_RING_SIZE;
+        for (uint64 n = thread->counter_head - count; n < thread->counter_head; n++) {
+            ProfileCounter *counter = &thread->counters[n & (PROFILER_COUNTER_RING_SIZE - 1)];
+            fprintf(fp,
+                    "%s{\"name\":\"%s\",\"ph\":\"C\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,"
+                    "\"args\":{\"value\":%.17g}}",
+                    first ? "" : ",\n", counter->name, thread->id,
+                    (counter->time - origin) / 1000.0, counter->value);
+            first = false;
+        }
+    }
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    fclose(fp);
+
+    log_info("PROFILER: Wrote trace to %s\n", path);
+    return true;
+}
+
+void profiler_destroy(void) {
+    uint32 thread_count = profiler_data.thread_count;
+    if (thread_count > PROFILER_MAX_THREADS) {
+        thread_count = PROFILER_MAX_THREADS;
+    }
+
+    for (uint32 i = 0; i < thread_count; i++) {
+        free(profiler_data.threads[i]);
+        profiler_data.threads[i] = NULL;
+    }
+    profiler_data.thread_count = 0;
+    profiler_local = NULL;
+}
+
+#endif
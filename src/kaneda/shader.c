@@ -1,86 +1,758 @@
 #include "shader.h"
 #include "file.h"
 #include "log.h"
+#include "pack.h"
+
+#include <stdio.h>
+
+#define SHADER_CACHE_MAGIC 0x4248534B // "KSHB"
+#define SHADER_CACHE_VERSION 1
+#define SHADER_MAX_SOURCES 64 // files one program can be built from, its stages included
+
+// Header in front of every cached program binary.
+typedef struct ShaderCacheHeader {
+    uint32 magic;
+    uint32 version;
+    uint64 key;
+    uint32 format; // the driver's binary format enum
+    uint32 length; // bytes of binary after the header
+} ShaderCacheHeader;
+
+// One stage of a program, the code doesn't need to be null terminated.
+typedef struct ShaderStage {
+    GLenum type;
+    const char *path;
+    const GLchar *code;
+    GLint length;
+} ShaderStage;
+
+// A growing buffer, for preprocessed code and the list of files it came from.
+typedef struct ShaderText {
+    char *data;
+    usize length;
+    usize capacity;
+} ShaderText;
+
+static uint64 shader_hash_bytes(uint64 hash, const void *data, usize size) {
+    const uint8 *bytes = (const uint8 *)data;
+    for (usize i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint64 shader_hash_string(uint64 hash, const char *string) {
+    // The terminator goes in too so "ab" + "c" and "a" + "bc" don't collide.
+    return string != NULL ? shader_hash_bytes(hash, string, strlen(string) + 1)
+                          : shader_hash_bytes(hash, "", 1);
+}
+
+// Everything that changes the binary: the code of every stage, the defines it was built with and
+// the driver that built it, a driver update invalidates the whole cache.
+static uint64 shader_cache_key(ShaderStage *stages, uint32 count, const char *defines) {
+    uint64 hash = 14695981039346656037ull;
+    uint32 version = SHADER_CACHE_VERSION;
+    hash = shader_hash_bytes(hash, &version, sizeof(version));
+    hash = shader_hash_string(hash, (const char *)glGetString(GL_VENDOR));
+    hash = shader_hash_string(hash, (const char *)glGetString(GL_RENDERER));
+    hash = shader_hash_string(hash, (const char *)glGetString(GL_VERSION));
+    hash = shader_hash_string(hash, defines);
+    for (uint32 i = 0; i < count; i++) {
+        hash = shader_hash_bytes(hash, &stages[i].type, sizeof(stages[i].type));
+        hash = shader_hash_bytes(hash, &stages[i].length, sizeof(stages[i].length));
+        hash = shader_hash_bytes(hash, stages[i].code, (usize)stages[i].length);
+    }
+    return hash;
+}
+
+static void shader_cache_path(uint64 key, char *path, usize size) {
+    snprintf(path, size, "%s/%016llx.bin", SHADER_CACHE_DIR, (unsigned long long)key);
+}
+
+static bool shader_cache_supported(void) {
+#ifdef NO_SHADER_CACHE
+    return false;
+#else
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+#endif
+}
+
+// A program straight from the cached binary, 0 when there's no usable one. Binaries the driver
+// won't take anymore are deleted so they get rebuilt.
+static GLuint shader_cache_load(uint64 key) {
+    char path[256];
+    shader_cache_path(key, path, sizeof(path));
+    if (!file_exists(path)) {
+        return 0;
+    }
+
+    file_view view = file_map(path);
+    if (view == NULL) {
+        return 0;
+    }
+    ShaderCacheHeader header = {0};
+    if (file_view_size(view) >= sizeof(header)) {
+        memcpy(&header, file_view_data(view), sizeof(header));
+    }
+    if (header.magic != SHADER_CACHE_MAGIC || header.version != SHADER_CACHE_VERSION ||
+        header.key != key || file_view_size(view) - sizeof(header) != header.length) {
+        log_warning("Shader cache %s is damaged, rebuilding it.\n", path);
+        file_unmap(view);
+        remove(path);
+        return 0;
+    }
+
+    GLuint program_id = glCreateProgram();
+    glProgramBinary(program_id, header.format, file_view_data(view) + sizeof(header),
+                    (GLsizei)header.length);
+    file_unmap(view);
+
+    GLint is_linked = GL_FALSE;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &is_linked);
+    if (!is_linked) {
+        log_info("Driver rejected cached program %s, recompiling.\n", path);
+        glDeleteProgram(program_id);
+        remove(path);
+        return 0;
+    }
+    return program_id;
+}
+
+static void shader_cache_mkdir(const char *path) {
+#ifdef PLATFORM_WINDOWS
+    CreateDirectory(path, NULL);
+#else
+    mkdir(path, 0755);
+#endif
+}
+
+static void shader_cache_store(uint64 key, GLuint program_id) {
+    GLint length = 0;
+    glGetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    Arena *scratch = arena_scratch();
+    usize mark = arena_mark(scratch);
+    uint8 *data = arena_push(scratch, sizeof(ShaderCacheHeader) + (usize)length);
+    if (data == NULL) {
+        arena_pop(scratch, mark);
+        return;
+    }
+    ShaderCacheHeader header = {
+        .magic = SHADER_CACHE_MAGIC, .version = SHADER_CACHE_VERSION, .key = key};
+    GLenum format = 0;
+    glGetProgramBinary(program_id, length, &length, &format, data + sizeof(header));
+    header.format = format;
+    header.length = (uint32)length;
+    memcpy(data, &header, sizeof(header));
+
+    // Make the directory one level at a time, then write under a temporary name and rename it so
+    // a crash mid write never leaves a truncated binary behind.
+    char path[256], temp[272];
+    snprintf(path, sizeof(path), "%s", SHADER_CACHE_DIR);
+    for (char *slash = path; (slash = strchr(slash + 1, '/')) != NULL;) {
+        *slash = '\0';
+        shader_cache_mkdir(path);
+        *slash = '/';
+    }
+    shader_cache_mkdir(path);
+    shader_cache_path(key, path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+    // Not file_open(), which exits when it can't open. A cache that can't be written, say in a
+    // read-only install, only costs the next run a recompile.
+    FILE *f = fopen(temp, "wb");
+    usize size = sizeof(header) + header.length;
+    bool is_written = f != NULL && fwrite(data, 1, size, f) == size;
+    if (f != NULL && fclose(f) != 0) {
+        is_written = false;
+    }
+    if (!is_written || rename(temp, path) != 0) {
+        log_warning("Unable to write shader cache %s.\n", path);
+        remove(temp);
+    }
+    arena_pop(scratch, mark);
+}
+
+// GL_KHR_parallel_shader_compile, or the ARB extension it came from. Not in the loader, so the
+// one entry point is fetched by hand.
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (*ShaderMaxCompilerThreads)(GLuint count);
+static bool shader_is_parallel = false;
+
+void shader_parallel_init(void) {
+    ShaderMaxCompilerThreads max_threads = NULL;
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+        max_threads = (ShaderMaxCompilerThreads)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    } else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile")) {
+        max_threads = (ShaderMaxCompilerThreads)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+    }
+    if (max_threads == NULL) {
+        log_info("No parallel shader compile, reloads will block the frame they finish on.\n");
+        return;
+    }
+    // As many compiler threads as the driver wants.
+    max_threads(0xFFFFFFFF);
+    shader_is_parallel = true;
+}
+
+// Issues compile and link without asking GL how they went, asking is what makes it wait.
+static GLuint shader_compile_begin(ShaderStage *stages, uint32 count, GLuint *shader_ids,
+                                   bool is_cached) {
+    for (uint32 i = 0; i < count; i++) {
+        log_info("Compiling shader: %s\n", stages[i].path);
+        shader_ids[i] = glCreateShader(stages[i].type);
+        glShaderSource(shader_ids[i], 1, &stages[i].code, &stages[i].length);
+        glCompileShader(shader_ids[i]);
+    }
+
+    // Link the program
+    GLuint program_id = glCreateProgram();
+    for (uint32 i = 0; i < count; i++) {
+        glAttachShader(program_id, shader_ids[i]);
+    }
+    if (is_cached) {
+        glProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(program_id);
+    return program_id;
+}
+
+// Logs whatever the compiler and linker had to say, true if the program is usable.
+static bool shader_compile_end(GLuint program_id, GLuint *shader_ids, uint32 count) {
+    bool is_compiled = true;
+    for (uint32 i = 0; i < count; i++) {
+        shader_check_shader_compile_errors(shader_ids[i]);
+        GLint status = GL_FALSE;
+        glGetShaderiv(shader_ids[i], GL_COMPILE_STATUS, &status);
+        is_compiled = is_compiled && status == GL_TRUE;
+    }
+    shader_check_program_compile_errors(program_id);
+
+    // delete the shaders as they're linked into our program now and no longer necessery
+    for (uint32 i = 0; i < count; i++) {
+        glDetachShader(program_id, shader_ids[i]);
+        glDeleteShader(shader_ids[i]);
+    }
+
+    GLint is_linked = GL_FALSE;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &is_linked);
+    return is_compiled && is_linked == GL_TRUE;
+}
+
+// Compile errors name files by number, this says which number is which.
+static void shader_log_sources(Shader *shader) {
+    const char *source = shader->sources;
+    for (uint32 i = 0; i < shader->source_count; i++, source += strlen(source) + 1) {
+        log_error("    > source %u is %s\n", i, source);
+    }
+}
+
+// Compiles and links the stages, or loads the program the last run cached for the same key.
+static bool shader_build(Shader *shader, ShaderStage *stages, uint32 count, const char *defines) {
+    bool is_cached = shader_cache_supported();
+    uint64 key = is_cached ? shader_cache_key(stages, count, defines) : 0;
+    GLuint program_id = is_cached ? shader_cache_load(key) : 0;
+    if (program_id != 0) {
+        log_info("Loaded cached program: %s\n", stages[0].path);
+        shader->program_id = program_id;
+        shader_reflect(shader);
+        return true;
+    }
+
+    GLuint shader_ids[3] = {0};
+    program_id = shader_compile_begin(stages, count, shader_ids, is_cached);
+    if (!shader_compile_end(program_id, shader_ids, count)) {
+        shader_log_sources(shader);
+        glDeleteProgram(program_id);
+        return false;
+    }
+    if (is_cached) {
+        shader_cache_store(key, program_id);
+    }
+
+    shader->program_id = program_id;
+    shader_reflect(shader);
+    return true;
+}
+
+static void shader_text_append(ShaderText *text, const char *data, usize size) {
+    if (text->length + size + 1 > text->capacity) {
+        text->capacity = text->capacity > 0 ? text->capacity : 4096;
+        while (text->length + size + 1 > text->capacity) {
+            text->capacity *= 2;
+        }
+        text->data = realloc(text->data, text->capacity);
+    }
+    memcpy(text->data + text->length, data, size);
+    text->length += size;
+    text->data[text->length] = '\0';
+}
+
+static void shader_text_line(ShaderText *text, uint32 line, uint32 source) {
+    char directive[32];
+    int size = snprintf(directive, sizeof(directive), "#line %u %u\n", line, source);
+    shader_text_append(text, directive, (usize)size);
+}
+
+// "NAME" or "NAME=VALUE" separated by whitespace, each one becomes a #define.
+static void shader_text_defines(ShaderText *text, const char *defines) {
+    while (defines != NULL && *defines != '\0') {
+        usize skip = strspn(defines, " \t\r\n");
+        defines += skip;
+        usize size = strcspn(defines, " \t\r\n");
+        if (size == 0) {
+            break;
+        }
+        const char *equals = memchr(defines, '=', size);
+        usize name_size = equals != NULL ? (usize)(equals - defines) : size;
+        shader_text_append(text, "#define ", 8);
+        shader_text_append(text, defines, name_size);
+        if (equals != NULL) {
+            shader_text_append(text, " ", 1);
+            shader_text_append(text, equals + 1, size - name_size - 1);
+        }
+        shader_text_append(text, "\n", 1);
+        defines += size;
+    }
+}
+
+// Index of path in the program's null separated source list, added if it isn't there yet.
+static uint32 shader_source_index(ShaderText *sources, uint32 *source_count, const char *path) {
+    const char *source = sources->data;
+    for (uint32 i = 0; i < *source_count; i++, source += strlen(source) + 1) {
+        if (strcmp(source, path) == 0) {
+            return i;
+        }
+    }
+    shader_text_append(sources, path, strlen(path) + 1);
+    return (*source_count)++;
+}
+
+// Sources come out of this pack when it has them, from loose files otherwise.
+static pack shader_pack = NULL;
+
+void shader_use_pack(pack p) {
+    shader_pack = p;
+}
+
+static bool shader_source_exists(const char *path) {
+    return (shader_pack != NULL && pack_find(shader_pack, path) != NULL) || file_exists(path);
+}
+
+// The whole source, null terminated, free() it when done.
+static char *shader_source_load(const char *path, usize *size) {
+    if (shader_pack != NULL && pack_find(shader_pack, path) != NULL) {
+        uint64 length = 0;
+        char *data = pack_load(shader_pack, path, &length);
+        *size = (usize)length;
+        return data;
+    }
+
+    file_view view = file_map(path);
+    if (view == NULL) {
+        return NULL;
+    }
+    *size = file_view_size(view);
+    char *data = malloc(*size + 1);
+    memcpy(data, file_view_data(view), *size);
+    data[*size] = '\0';
+    file_unmap(view);
+    return data;
+}
+
+// Skips spaces and tabs, plus line breaks when `is_multiline`, stopping at `end`.
+static const char *shader_skip_space(const char *text, const char *end, bool is_multiline) {
+    while (text < end && (*text == ' ' || *text == '\t' ||
+                          (is_multiline && (*text == '\r' || *text == '\n')))) {
+        text++;
+    }
+    return text;
+}
+
+// Appends a file to the stage's code with its #include "file" lines replaced by the files, paths
+// relative to the including file. Each file goes in once per stage, so includes behave as if
+// they had guards and cycles end. #line directives number every file by its place in sources,
+// which is what compile errors report. The stage's defines go in right after its #version.
+static bool shader_preprocess(ShaderText *code, ShaderText *sources, uint32 *source_count,
+                              uint64 *included, const char *path, const char *defines) {
+    uint32 source = shader_source_index(sources, source_count, path);
+    if (source >= SHADER_MAX_SOURCES) {
+        log_error("%s pulls in more than SHADER_MAX_SOURCES files.\n", path);
+        return false;
+    }
+    if (*included & (1ull << source)) {
+        return true;
+    }
+    bool is_stage = *included == 0;
+    *included |= 1ull << source;
+
+    usize size = 0;
+    char *data = shader_source_load(path, &size);
+    if (data == NULL) {
+        return false;
+    }
+    const char *text = data;
+    const char *end = text + size;
+
+    uint32 line = 1;
+    if (is_stage) {
+        const char *first = shader_skip_space(text, end, true);
+        if (end - first >= 8 && strncmp(first, "#version", 8) == 0) {
+            const char *newline = memchr(first, '\n', (usize)(end - first));
+            const char *after = newline != NULL ? newline + 1 : end;
+            shader_text_append(code, text, (usize)(after - text));
+            for (const char *c = text; c < after; c++) {
+                line += *c == '\n';
+            }
+            text = after;
+        }
+        shader_text_defines(code, defines);
+    }
+    shader_text_line(code, line, source);
+
+    bool is_ok = true;
+    while (text < end) {
+        const char *newline = memchr(text, '\n', (usize)(end - text));
+        const char *next = newline != NULL ? newline + 1 : end;
+
+        // Both the # and the keyword can have whitespace in front of them.
+        const char *c = shader_skip_space(text, next, false);
+        bool is_include = false;
+        if (c < next && *c == '#') {
+            c = shader_skip_space(c + 1, next, false);
+            is_include = next - c > 7 && strncmp(c, "include", 7) == 0;
+        }
+
+        if (is_include) {
+            const char *open = memchr(c, '"', (usize)(next - c));
+            const char *close = NULL;
+            if (open != NULL) {
+                close = memchr(open + 1, '"', (usize)(next - open - 1));
+            }
+            const char *slash = strrchr(path, '/');
+            usize directory = slash != NULL ? (usize)(slash - path) + 1 : 0;
+            char include[256];
+            if (close == NULL || directory + (usize)(close - open - 1) >= sizeof(include)) {
+                log_error("%s:%u has a malformed #include.\n", path, line);
+                is_ok = false;
+                break;
+            }
+            snprintf(include, sizeof(include), "%.*s%.*s", (int)directory, path,
+                     (int)(close - open - 1), open + 1);
+            if (!shader_source_exists(include)) {
+                log_error("%s:%u includes %s, which doesn't exist.\n", path, line, include);
+                is_ok = false;
+                break;
+            }
+            if (!shader_preprocess(code, sources, source_count, included, include, NULL)) {
+                is_ok = false;
+                break;
+            }
+            shader_text_line(code, line + 1, source);
+        } else {
+            shader_text_append(code, text, (usize)(next - text));
+        }
+        text = next;
+        line++;
+    }
+    if (code->length > 0 && code->data[code->length - 1] != '\n') {
+        shader_text_append(code, "\n", 1);
+    }
+    free(data);
+    return is_ok;
+}
+
+// Preprocesses every stage of the shader. On success the shader's source list is replaced with
+// the files this build read, the caller frees the codes once the compile is issued.
+static bool shader_prepare_stages(Shader *shader, ShaderText *codes, ShaderStage *stages,
+                                  uint32 *count) {
+    const GLenum types[3] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER};
+    const char *names[3] = {"vertex", "fragment", "geometry"};
+    *count = shader->paths[2] != NULL ? 3 : 2;
+
+    ShaderText sources = {0};
+    uint32 source_count = 0;
+    for (uint32 i = 0; i < *count; i++) {
+        codes[i] = (ShaderText){0};
+        uint64 included = 0;
+        if (!shader_source_exists(shader->paths[i]) ||
+            !shader_preprocess(&codes[i], &sources, &source_count, &included, shader->paths[i],
+                               shader->defines)) {
+            log_error("Unable to read %s shader code. Check the file path.\n", names[i]);
+            for (uint32 j = 0; j <= i; j++) {
+                free(codes[j].data);
+            }
+            free(sources.data);
+            return false;
+        }
+        stages[i] = (ShaderStage){.type = types[i],
+                                  .path = shader->paths[i],
+                                  .code = codes[i].data,
+                                  .length = (GLint)codes[i].length};
+    }
+
+    free(shader->sources);
+    shader->sources = sources.data;
+    shader->source_count = source_count;
+    return true;
+}
 
 bool shader_create(Shader *shader, const char *vert_path, const char *frag_path,
-                   const char *geom_path) {
+                   const char *geom_path, const char *defines) {
     if (vert_path == NULL || frag_path == NULL) {
         log_fatal("Vertex or Fragment shader paths not specified in shader creation.\n");
         return false;
     }
 
-    // Read the Vertex Shader code from the file
-    const char *vert_code = (const char *)shader_read_from_file(vert_path);
-    if (vert_code == NULL) {
-        log_error("Unable to read vertex shader code. Check the file path.");
+    *shader = (Shader){
+        .paths = {vert_path, frag_path, geom_path},
+        .defines = defines != NULL ? strdup(defines) : NULL,
+        .permutation = shader_permutation_key(vert_path, frag_path, geom_path, defines),
+    };
+    ShaderText codes[3];
+    ShaderStage stages[3];
+    uint32 count = 0;
+    if (!shader_prepare_stages(shader, codes, stages, &count)) {
+        free(shader->defines);
+        shader->defines = NULL;
         return false;
     }
 
-    const char *frag_code = (const char *)shader_read_from_file(frag_path);
-    if (frag_code == NULL) {
-        log_error("Unable to read fragment shader code. Check the file path.");
-        return false;
+    bool is_built = shader_build(shader, stages, count, shader->defines);
+    for (uint32 i = 0; i < count; i++) {
+        free(codes[i].data);
     }
+    if (!is_built) {
+        shader_destroy(shader);
+    }
+    return is_built;
+}
 
-    // Create the shaders
-    GLuint vert_shader_id = glCreateShader(GL_VERTEX_SHADER);
-    GLuint frag_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
+uint64 shader_permutation_key(const char *vert_path, const char *frag_path, const char *geom_path,
+                              const char *defines) {
+    uint64 hash = 14695981039346656037ull;
+    hash = shader_hash_string(hash, vert_path);
+    hash = shader_hash_string(hash, frag_path);
+    hash = shader_hash_string(hash, geom_path);
+    return shader_hash_string(hash, defines);
+}
 
-    // Compile Vertex Shader
-    log_info("Compiling shader: %s\n", vert_path);
-    glShaderSource(vert_shader_id, 1, &vert_code, NULL);
-    glCompileShader(vert_shader_id);
-    shader_check_shader_compile_errors(vert_shader_id);
+// True if path is any file the program was last built from, included ones too.
+bool shader_uses_path(Shader *shader, const char *path) {
+    const char *source = shader->sources;
+    for (uint32 i = 0; i < shader->source_count; i++, source += strlen(source) + 1) {
+        if (strcmp(source, path) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    // Compile Fragment Shader
-    log_info("Compiling shader: %s\n", frag_path);
-    glShaderSource(frag_shader_id, 1, &frag_code, NULL);
-    glCompileShader(frag_shader_id);
-    shader_check_shader_compile_errors(frag_shader_id);
+// Rereads the sources and starts building a replacement program next to the current one, which
+// stays in use until shader_reload_poll() swaps it. A reload already in flight is dropped.
+bool shader_reload_begin(Shader *shader) {
+    ShaderReload *reload = &shader->reload;
+    if (reload->program_id != 0) {
+        for (uint32 i = 0; i < reload->count; i++) {
+            glDeleteShader(reload->shader_ids[i]);
+        }
+        glDeleteProgram(reload->program_id);
+        reload->program_id = 0;
+    }
+
+    ShaderText codes[3];
+    ShaderStage stages[3];
+    uint32 count = 0;
+    if (!shader_prepare_stages(shader, codes, stages, &count)) {
+        return false;
+    }
 
-    GLuint geom_shader_id;
-    if (geom_path != NULL) {
-        const char *geom_code = (const char *)shader_read_from_file(frag_path);
-        if (geom_code == NULL) {
-            log_error("Unable to read geometry shader code. Check the file path.");
+    bool is_cached = shader_cache_supported();
+    reload->count = count;
+    reload->key = is_cached ? shader_cache_key(stages, count, shader->defines) : 0;
+    reload->program_id = shader_compile_begin(stages, count, reload->shader_ids, is_cached);
+    for (uint32 i = 0; i < count; i++) {
+        free(codes[i].data);
+    }
+    return true;
+}
+
+// Call once a frame while a reload is in flight. Returns false until it's finished: swapped in if
+// it built, thrown away with the errors logged if it didn't.
+bool shader_reload_poll(Shader *shader) {
+    ShaderReload *reload = &shader->reload;
+    if (reload->program_id == 0) {
+        return true;
+    }
+    if (shader_is_parallel) {
+        GLint is_complete = GL_FALSE;
+        glGetProgramiv(reload->program_id, GL_COMPLETION_STATUS_KHR, &is_complete);
+        if (!is_complete) {
             return false;
         }
-        geom_shader_id = glCreateShader(GL_GEOMETRY_SHADER);
-        log_info("Compiling shader: %s\n", geom_path);
-        glShaderSource(geom_shader_id, 1, &geom_code, NULL);
-        glCompileShader(geom_shader_id);
-        shader_check_shader_compile_errors(geom_shader_id);
     }
 
-    // Link the program
-    log_info("Linking program...\n");
-    GLuint program_id = glCreateProgram();
-    glAttachShader(program_id, vert_shader_id);
-    glAttachShader(program_id, frag_shader_id);
-    if (geom_path != NULL) {
-        glAttachShader(program_id, geom_shader_id);
+    GLuint program_id = reload->program_id;
+    reload->program_id = 0;
+    if (!shader_compile_end(program_id, reload->shader_ids, reload->count)) {
+        shader_log_sources(shader);
+        log_error("Reloading %s failed, keeping the old program.\n", shader->paths[0]);
+        glDeleteProgram(program_id);
+        return true;
     }
-    glLinkProgram(program_id);
-    shader_check_program_compile_errors(program_id);
-
-    // delete the shaders as they're linked into our program now and no longer necessery
-    glDeleteShader(vert_shader_id);
-    glDeleteShader(frag_shader_id);
-    if (geom_path != NULL) {
-        glDeleteShader(geom_shader_id);
+    if (reload->key != 0) {
+        shader_cache_store(reload->key, program_id);
     }
 
+    // Frames only ever see the old program or the new one, never something in between.
+    glDeleteProgram(shader->program_id);
     shader->program_id = program_id;
+    shader_reflect(shader);
+    log_info("Reloaded program: %s\n", shader->paths[0]);
     return true;
 }
 
+static uint32 shader_hash(const char *name, usize size) {
+    uint32 hash = 2166136261u;
+    for (usize i = 0; i < size; i++) {
+        hash ^= (uint8)name[i];
+        hash *= 16777619u;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+static void shader_insert(Shader *shader, const char *name, GLint location) {
+    uint32 hash = shader_hash(name, strlen(name));
+    uint32 mask = shader->uniform_capacity - 1;
+    uint32 slot = hash & mask;
+    while (shader->uniforms[slot].hash != 0) {
+        slot = (slot + 1) & mask;
+    }
+    shader->uniforms[slot] = (ShaderUniform){.hash = hash, .location = location, .name = name};
+}
+
+// Builds the uniform location table and points the Frame and Object blocks at their binding
+// points. Run it again whenever the program is relinked.
+void shader_reflect(Shader *shader) {
+    GLuint program_id = shader->program_id;
+    free(shader->uniforms);
+    free(shader->uniform_names);
+    shader->uniforms = NULL;
+    shader->uniform_names = NULL;
+    shader->uniform_capacity = 0;
+
+    GLint count = 0, max_length = 0;
+    glGetProgramiv(program_id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    if (count > 0 && max_length > 0) {
+        // Arrays are reported as "name[0]" and get a second entry under "name", so up to two
+        // names per uniform and the table is kept under half full.
+        shader->uniform_capacity = 4;
+        while (shader->uniform_capacity < (uint32)count * 4) {
+            shader->uniform_capacity *= 2;
+        }
+        shader->uniforms = calloc(shader->uniform_capacity, sizeof(ShaderUniform));
+        shader->uniform_names = malloc((usize)count * 2 * (max_length + 1));
+
+        char *name = shader->uniform_names;
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program_id, (GLuint)i, max_length + 1, &length, &size, &type, name);
+            name[length] = '\0';
+
+            // Block members and built-ins have no location.
+            GLint location = glGetUniformLocation(program_id, name);
+            if (location < 0) {
+                continue;
+            }
+            shader_insert(shader, name, location);
+            char *next = name + length + 1;
+            if (length > 3 && strcmp(name + length - 3, "[0]") == 0) {
+                memcpy(next, name, length - 3);
+                next[length - 3] = '\0';
+                shader_insert(shader, next, location);
+                next += length - 2;
+            }
+            name = next;
+        }
+    }
+
+    GLint block_count = 0;
+    glGetProgramiv(program_id, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+    char block[64]; // only Frame and Object matter here, longer names can be cut short
+    for (GLint i = 0; i < block_count; i++) {
+        glGetActiveUniformBlockName(program_id, (GLuint)i, sizeof(block), NULL, block);
+        GLint size = 0;
+        glGetActiveUniformBlockiv(program_id, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+
+        if (strcmp(block, "Frame") == 0) {
+            glUniformBlockBinding(program_id, (GLuint)i, SHADER_BLOCK_FRAME);
+            if ((usize)size != sizeof(FrameUniforms)) {
+                log_warning("Frame block is %d bytes, FrameUniforms is %zu. Is it std140?\n", size,
+                            sizeof(FrameUniforms));
+            }
+        } else if (strcmp(block, "Object") == 0) {
+            glUniformBlockBinding(program_id, (GLuint)i, SHADER_BLOCK_OBJECT);
+            if ((usize)size != sizeof(ObjectUniforms)) {
+                log_warning("Object block is %d bytes, ObjectUniforms is %zu. Is it std140?\n",
+                            size, sizeof(ObjectUniforms));
+            }
+        }
+    }
+}
+
+// -1 if the program has no such uniform, same as GL, which ignores sets to -1.
+GLint shader_uniform_location(Shader *shader, const char *name) {
+    if (shader->uniform_capacity == 0) {
+        return -1;
+    }
+
+    uint32 hash = shader_hash(name, strlen(name));
+    uint32 mask = shader->uniform_capacity - 1;
+    for (uint32 slot = hash & mask;; slot = (slot + 1) & mask) {
+        ShaderUniform *uniform = &shader->uniforms[slot];
+        if (uniform->hash == 0) {
+            return -1;
+        }
+        if (uniform->hash == hash && strcmp(uniform->name, name) == 0) {
+            return uniform->location;
+        }
+    }
+}
+
+// Points any other uniform block at a binding point, Frame and Object are bound on their own.
+void shader_block_bind(Shader *shader, const char *block, GLuint binding) {
+    GLuint index = glGetUniformBlockIndex(shader->program_id, block);
+    if (index == GL_INVALID_INDEX) {
+        log_warning("Program %u has no uniform block %s.\n", shader->program_id, block);
+        return;
+    }
+    glUniformBlockBinding(shader->program_id, index, binding);
+}
+
+// The code lives in the calling thread's scratch arena, take a mark first and pop it when done.
 char *shader_read_from_file(const char *path) {
-    file f = file_open(path, FILE_MODE_READ);
-    char *code;
-    code = malloc(sizeof(*code) * f->size);
-    file_read(f, 0, f->size, code);
-    code[f->size] = '\0';
-    file_close(f);
+    file_view view = file_map(path);
+    if (view == NULL) {
+        return NULL;
+    }
+    usize size = file_view_size(view);
+    char *code = arena_push(arena_scratch(), size + 1);
+    if (code == NULL) {
+        file_unmap(view);
+        return NULL;
+    }
+    memcpy(code, file_view_data(view), size);
+    code[size] = '\0';
+    file_unmap(view);
     // printf("\nCODE--------\n%s\n------------", code);
 
     return code;
@@ -97,10 +769,14 @@ void shader_check_shader_compile_errors(GLuint shader_id) {
     glGetShaderiv(shader_id, GL_COMPILE_STATUS, &result);
     glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &info_log_length);
     if (info_log_length > 0) {
-        const char *error_msg = malloc(sizeof(const char *) * (info_log_length + 1));
-        glGetShaderInfoLog(shader_id, info_log_length, NULL, &error_msg[0]);
-        log_error("%s\n", &error_msg[0]);
-        free(error_msg);
+        Arena *scratch = arena_scratch();
+        usize mark = arena_mark(scratch);
+        char *error_msg = arena_push(scratch, info_log_length + 1);
+        if (error_msg != NULL) {
+            glGetShaderInfoLog(shader_id, info_log_length, NULL, &error_msg[0]);
+            log_error("%s\n", &error_msg[0]);
+        }
+        arena_pop(scratch, mark);
     }
 }
 
@@ -111,13 +787,34 @@ void shader_check_program_compile_errors(GLuint program_id) {
     glGetProgramiv(program_id, GL_LINK_STATUS, &result);
     glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &info_log_length);
     if (info_log_length > 0) {
-        const char *error_msg = malloc(sizeof(const char *) * (info_log_length + 1));
-        glGetShaderInfoLog(program_id, info_log_length, NULL, &error_msg[0]);
-        log_error("%s\n", &error_msg[0]);
-        free(error_msg);
+        Arena *scratch = arena_scratch();
+        usize mark = arena_mark(scratch);
+        char *error_msg = arena_push(scratch, info_log_length + 1);
+        if (error_msg != NULL) {
+            glGetProgramInfoLog(program_id, info_log_length, NULL, &error_msg[0]);
+            log_error("%s\n", &error_msg[0]);
+        }
+        arena_pop(scratch, mark);
     }
 }
 
 void shader_destroy(Shader *shader) {
+    if (shader->reload.program_id != 0) {
+        for (uint32 i = 0; i < shader->reload.count; i++) {
+            glDeleteShader(shader->reload.shader_ids[i]);
+        }
+        glDeleteProgram(shader->reload.program_id);
+        shader->reload.program_id = 0;
+    }
     glDeleteProgram(shader->program_id);
+    free(shader->uniforms);
+    free(shader->uniform_names);
+    free(shader->defines);
+    free(shader->sources);
+    shader->uniforms = NULL;
+    shader->uniform_names = NULL;
+    shader->uniform_capacity = 0;
+    shader->defines = NULL;
+    shader->sources = NULL;
+    shader->source_count = 0;
 }
\ No newline at end of file
@@ -2,58 +2,124 @@
 #define SHADER_H
 
 #include "core.h"
+#include "pack.h"
+
+#define SHADER_BLOCK_FRAME 0  // binding point of every program's "Frame" uniform block
+#define SHADER_BLOCK_OBJECT 1 // binding point of every program's "Object" uniform block
+
+typedef struct ShaderUniform {
+    uint32 hash; // 0 marks an empty slot
+    GLint location;
+    const char *name;
+} ShaderUniform;
+
+// A replacement program being compiled and linked while the current one stays in use.
+typedef struct ShaderReload {
+    GLuint program_id; // 0 when no reload is in flight
+    GLuint shader_ids[3];
+    uint32 count;
+    uint64 key; // shader cache key, 0 when binaries aren't cached
+} ShaderReload;
 
 typedef struct {
     GLuint program_id;
+    // Active uniforms reflected at link time, open addressed on the name hash. Uniforms inside
+    // blocks aren't in here, they're set through uniform buffers.
+    ShaderUniform *uniforms;
+    uint32 uniform_capacity; // power of two, 0 if the program has no loose uniforms
+    char *uniform_names;
+    const char *paths[3]; // vert, frag and geom (or NULL) sources, kept for reloading
+    char *defines;        // the permutation's defines, NULL for none
+    uint64 permutation;   // shader_permutation_key() of the paths and defines
+    uint32 references;    // shader_load() calls sharing this permutation
+    // Every file the program was last built from, null separated, the stages and whatever they
+    // #include. The n-th one is source n in compile errors.
+    char *sources;
+    uint32 source_count;
+    ShaderReload reload;
 } Shader;
 
+/* The per-frame and per-object uniform blocks, laid out std140 so they can be copied straight
+    into a uniform buffer. Only mat4 and vec4 members, anything smaller needs explicit padding.
+    GLSL side:
+
+    layout(std140) uniform Frame { mat4 projection; mat4 view; mat4 view_projection;
+                                   vec4 camera_position; vec4 time; };
+    layout(std140) uniform Object { mat4 model; vec4 color; }; */
+typedef struct FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    mat4 view_projection;
+    vec4 camera_position; // w unused
+    vec4 time;            // seconds elapsed, frame delta in seconds, interpolation alpha, unused
+} FrameUniforms;
+
+typedef struct ObjectUniforms {
+    mat4 model;
+    vec4 color;
+} ObjectUniforms;
+
 /* geom_path can be NULL, because we might not always want to specify it, but
-    vert_path & frag_path should always have values.*/
+    vert_path & frag_path should always have values.
+    Sources are preprocessed first: #include "file" pulls in a file relative to the one including
+    it, once per stage, and defines ("NAME" or "NAME=VALUE" separated by whitespace, or NULL) go
+    in as #defines right after #version. That's how one source gets specialized permutations,
+    e.g. "NO_TEXTURE ALPHA_TEST=0", instead of branching on uniforms at runtime.*/
 bool shader_create(Shader *shader, const char *vert_path, const char *frag_path,
-                   const char *geom_path);
+                   const char *geom_path, const char *defines);
+uint64 shader_permutation_key(const char *vert_path, const char *frag_path, const char *geom_path,
+                              const char *defines);
 void shader_destroy(Shader *shader);
 char *shader_read_from_file(const char *path);
 void shader_use(Shader *shader);
 void shader_check_shader_compile_errors(GLuint shader_id);
 void shader_check_program_compile_errors(GLuint program_id);
+void shader_reflect(Shader *shader);
+GLint shader_uniform_location(Shader *shader, const char *name);
+void shader_block_bind(Shader *shader, const char *block, GLuint binding);
+void shader_use_pack(pack p);
+void shader_parallel_init(void);
+bool shader_uses_path(Shader *shader, const char *path);
+bool shader_reload_begin(Shader *shader);
+bool shader_reload_poll(Shader *shader);
 
-// utility uniform functions
+// utility uniform functions, the locations come from the table built at link time
 static inline void shader_shader_set__bool(Shader *shader, const char *name, const bool value) {
-    glUniform1i(glGetUniformLocation(shader->program_id, name), (int)value);
+    glUniform1i(shader_uniform_location(shader, name), (int)value);
 }
 
 static inline void shader_set_int(Shader *shader, const char *name, const int value) {
-    glUniform1i(glGetUniformLocation(shader->program_id, name), value);
+    glUniform1i(shader_uniform_location(shader, name), value);
 }
 
 static inline void shader_set_float(Shader *shader, const char *name, const float value) {
-    glUniform1f(glGetUniformLocation(shader->program_id, name), value);
+    glUniform1f(shader_uniform_location(shader, name), value);
 }
 
 static inline void shader_set_vec2(Shader *shader, const char *name, const float x, const float y) {
-    glUniform2f(glGetUniformLocation(shader->program_id, name), x, y);
+    glUniform2f(shader_uniform_location(shader, name), x, y);
 }
 
 static inline void shader_set_vec3(Shader *shader, const char *name, const float x, const float y,
                                    const float z) {
-    glUniform3f(glGetUniformLocation(shader->program_id, name), x, y, z);
+    glUniform3f(shader_uniform_location(shader, name), x, y, z);
 }
 
 static inline void shader_set_vec4(Shader *shader, const char *name, const float x, const float y,
                                    const float z, const float w) {
-    glUniform4f(glGetUniformLocation(shader->program_id, name), x, y, z, w);
+    glUniform4f(shader_uniform_location(shader, name), x, y, z, w);
 }
 
 static inline void shader_set_mat2(Shader *shader, const char *name, const float *mat) {
-    glUniformMatrix2fv(glGetUniformLocation(shader->program_id, name), 1, GL_FALSE, &mat[0]);
+    glUniformMatrix2fv(shader_uniform_location(shader, name), 1, GL_FALSE, &mat[0]);
 }
 
 static inline void shader_set_mat3(Shader *shader, const char *name, const float *mat) {
-    glUniformMatrix3fv(glGetUniformLocation(shader->program_id, name), 1, GL_FALSE, &mat[0]);
+    glUniformMatrix3fv(shader_uniform_location(shader, name), 1, GL_FALSE, &mat[0]);
 }
 
 static inline void shader_set_mat4(Shader *shader, const char *name, const float *mat) {
-    glUniformMatrix4fv(glGetUniformLocation(shader->program_id, name), 1, GL_FALSE, &mat[0]);
+    glUniformMatrix4fv(shader_uniform_location(shader, name), 1, GL_FALSE, &mat[0]);
 }
 
 #endif
\ No newline at end of file
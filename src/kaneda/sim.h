@@ -0,0 +1,163 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include "core.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_SNAPSHOT_FRESH 4 // set in SimThread.ready while the renderer hasn't taken the slot
+
+/*
+███████╗██╗███╗   ███╗    ████████╗██╗  ██╗██████╗ ███████╗ █████╗ ██████╗
+██╔════╝██║████╗ ████║    ╚══██╔══╝██║  ██║██╔══██╗██╔════╝██╔══██╗██╔══██╗
+███████╗██║██╔████╔██║       ██║   ███████║██████╔╝█████╗  ███████║██║  ██║
+╚════██║██║██║╚██╔╝██║       ██║   ██╔══██║██╔══██╗██╔══╝  ██╔══██║██║  ██║
+███████║██║██║ ╚═╝ ██║       ██║   ██║  ██║██║  ██║███████╗██║  ██║██████╔╝
+╚══════╝╚═╝╚═╝     ╚═╝       ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚══════╝╚═╝  ╚═╝╚═════╝
+With Game.flags.use_sim_thread the window thread only polls, draws and swaps while update() runs
+here at the tick rate. After every step the game copies what draw() needs into a snapshot through
+Game.snapshot(), and draw() reads the newest one with engine_snapshot(). A slow tick delays the
+next snapshot, not the next frame, so frame time is the slower of the two instead of their sum.
+
+Input events are still produced on the window thread and drained here. Gamepad axes are written
+straight into Input by the window thread, so they may be a frame stale or mid-update.
+
+Only Linux and macOS have the thread so far, elsewhere update() stays on the main thread.
+*/
+
+// Sim thread only. Copies the game state into the write slot and swaps it in as the newest.
+void sim_publish(SimThread *sim) {
+    if (engine()->game.snapshot != NULL) {
+        engine()->game.snapshot(sim->slots[sim->write]);
+    }
+    sim->published[sim->write] = time_elapsed();
+    sim->updates[sim->write] = sim->time.update;
+    sim->steps[sim->write] = sim->time.step;
+
+    uint32 previous =
+        __atomic_exchange_n(&sim->ready, sim->write | SIM_SNAPSHOT_FRESH, __ATOMIC_ACQ_REL);
+    sim->write = previous & (SIM_SNAPSHOT_FRESH - 1);
+    sim->snapshots++;
+}
+
+// Render thread only. Swaps in the newest snapshot if one was published since the last call.
+bool sim_acquire(SimThread *sim) {
+    if ((__atomic_load_n(&sim->ready, __ATOMIC_ACQUIRE) & SIM_SNAPSHOT_FRESH) == 0) {
+        return false;
+    }
+
+    uint32 previous = __atomic_exchange_n(&sim->ready, sim->read, __ATOMIC_ACQ_REL);
+    sim->read = previous & (SIM_SNAPSHOT_FRESH - 1);
+
+    // The acquire above makes the slot's timings visible, the sim thread's clock never is.
+    Time *time = &engine()->platform->time;
+    time->update = sim->updates[sim->read];
+    time->step = sim->steps[sim->read];
+    time->delta = time->step / 1000000000.0;
+    return true;
+}
+
+// How far past the snapshot being drawn the simulation has moved, in ticks [0..1].
+float64 sim_alpha(SimThread *sim) {
+    uint64 tick = engine()->platform->time.tick;
+    uint64 published = sim->published[sim->read];
+    if (tick == 0 || published == 0) {
+        return 1.0;
+    }
+
+    float64 alpha = (float64)(time_elapsed() - published) / tick;
+    return alpha < 1.0 ? alpha : 1.0;
+}
+
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+static void *sim_loop(void *arg) {
+    SimThread *sim = (SimThread *)arg;
+    Platform *platform = engine()->platform;
+    Time *time = &sim->time;
+    engine_time_local = time;
+
+    while (__atomic_load_n(&sim->is_running, __ATOMIC_ACQUIRE)) {
+        uint64 start = time_elapsed();
+        PROFILE_BEGIN("sim");
+        platform_update_input(platform, time);
+        // A replay that just ran out has already called engine_quit().
+        bool is_running = __atomic_load_n(&engine()->game.is_running, __ATOMIC_ACQUIRE) &&
+                          engine_simulate(time, true);
+        time->update = time_elapsed() - start;
+        if (is_running) {
+            sim_publish(sim);
+        }
+        arena_frame_reset();
+        PROFILE_END();
+        if (!is_running) {
+            break;
+        }
+
+        pacer_wait(&sim->pacer);
+        // A replayed journal sets the step itself at the top of the next loop.
+        if (!platform->journal.is_replaying) {
+            time->step = time->is_virtual ? time->virtual_step : time_elapsed() - start;
+            time->delta = time->step / 1000000000.0;
+        }
+    }
+
+    arena_thread_release();
+    return NULL;
+}
+#endif
+
+// Starts update() on its own thread. Runs at the tick rate, or the frame rate without one.
+SimThread *sim_create(uint32 snapshot_size) {
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+    SimThread *sim = kamalloc_init(SimThread);
+    sim->size = snapshot_size;
+    for (uint32 i = 0; i < 3; i++) {
+        sim->slots[i] = calloc(1, snapshot_size > 0 ? snapshot_size : 1);
+    }
+    sim->read = 0;
+    sim->write = 1;
+    sim->ready = 2;
+    // Tick and virtual clock settings carry over, from here on the copy is the sim thread's.
+    sim->time = engine()->platform->time;
+
+    Game *game = &engine()->game;
+    pacer_init(&sim->pacer, game->tick_rate > 0.f ? game->tick_rate : game->frame_rate);
+
+    sim->is_running = true;
+    if (pthread_create(&sim->thread, NULL, sim_loop, sim) != 0) {
+        log_error("Unable to start the sim thread, updating on the main thread.\n");
+        for (uint32 i = 0; i < 3; i++) {
+            free(sim->slots[i]);
+        }
+        free(sim);
+        return NULL;
+    }
+
+    log_info("SIM: update() running on its own thread, %u byte snapshots.\n", snapshot_size);
+    return sim;
+#else
+    log_warning("No sim thread on this platform yet, updating on the main thread.\n");
+    return NULL;
+#endif
+}
+
+void sim_destroy(SimThread *sim) {
+    if (sim == NULL) {
+        return;
+    }
+
+    __atomic_store_n(&sim->is_running, false, __ATOMIC_RELEASE);
+#if (defined PLATFORM_OSX || defined PLATFORM_LINUX)
+    pthread_join(sim->thread, NULL);
+#endif
+
+    log_info("SIM: %llu snapshots published.\n", (unsigned long long)sim->snapshots);
+    for (uint32 i = 0; i < 3; i++) {
+        free(sim->slots[i]);
+    }
+    free(sim);
+}
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "core.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+███████╗████████╗ █████╗ ████████╗███████╗
+██╔════╝╚══██╔══╝██╔══██╗╚══██╔══╝██╔════╝
+███████╗   ██║   ███████║   ██║   ███████╗
+╚════██║   ██║   ██╔══██║   ██║   ╚════██║
+███████║   ██║   ██║  ██║   ██║   ███████║
+╚══════╝   ╚═╝   ╚═╝  ╚═╝   ╚═╝   ╚══════╝
+Keeps the last `capacity` frames of every Time measurement so we can talk about tail latency
+instead of average FPS. Recording is a couple of stores per frame; percentiles sort a copy of the
+ring, so only ask for them when you're about to show or log them.
+*/
+
+static const char *frame_stat_names[FRAME_STAT_COUNT] = {"frame", "update", "render", "gpu"};
+
+void stats_init(FrameStats *stats, uint32 capacity, uint64 hitch_threshold) {
+    *stats = (FrameStats){0};
+    stats->capacity = capacity;
+    stats->hitch_threshold = hitch_threshold;
+
+    for (uint32 i = 0; i < FRAME_STAT_COUNT; i++) {
+        stats->samples[i] = calloc(capacity, sizeof(uint64));
+    }
+    stats->scratch = calloc(capacity, sizeof(uint64));
+}
+
+void stats_record(FrameStats *stats, Time *time) {
+    if (stats->capacity == 0) {
+        return;
+    }
+
+    stats->samples[FRAME_STAT_FRAME][stats->head] = time->frame;
+    stats->samples[FRAME_STAT_UPDATE][stats->head] = time->update;
+    stats->samples[FRAME_STAT_RENDER][stats->head] = time->render;
+    stats->samples[FRAME_STAT_GPU][stats->head] = time->gpu;
+
+    stats->head = (stats->head + 1) % stats->capacity;
+    if (stats->count < stats->capacity) {
+        stats->count++;
+    }
+
+    stats->frames++;
+    if (stats->hitch_threshold > 0 && time->frame > stats->hitch_threshold) {
+        stats->hitches++;
+    }
+}
+
+static int stats_compare(const void *a, const void *b) {
+    uint64 x = *(const uint64 *)a;
+    uint64 y = *(const uint64 *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of an already sorted array, p in [0..1].
+static uint64 stats_percentile(uint64 *sorted, uint32 count, float64 p) {
+    uint32 rank = (uint32)(p * count + 0.999999);
+    if (rank == 0) {
+        rank = 1;
+    }
+    if (rank > count) {
+        rank = count;
+    }
+    return sorted[rank - 1];
+}
+
+FrameSummary stats_summary(FrameStats *stats, FrameStat stat) {
+    FrameSummary summary = {0};
+    if (stats->count == 0 || stat >= FRAME_STAT_COUNT) {
+        return summary;
+    }
+
+    uint64 total = 0;
+    for (uint32 i = 0; i < stats->count; i++) {
+        stats->scratch[i] = stats->samples[stat][i];
+        total += stats->scratch[i];
+    }
+    qsort(stats->scratch, stats->count, sizeof(uint64), stats_compare);
+
+    summary.min = stats->scratch[0];
+    summary.max = stats->scratch[stats->count - 1];
+    summary.mean = (float64)total / stats->count;
+    summary.p50 = stats_percentile(stats->scratch, stats->count, 0.50);
+    summary.p95 = stats_percentile(stats->scratch, stats->count, 0.95);
+    summary.p99 = stats_percentile(stats->scratch, stats->count, 0.99);
+    summary.p999 = stats_percentile(stats->scratch, stats->count, 0.999);
+    return summary;
+}
+
+// Mean of the newest `frames` samples, cheap enough to call every frame.
+float64 stats_recent_mean(FrameStats *stats, FrameStat stat, uint32 frames) {
+    if (frames > stats->count) {
+        frames = stats->count;
+    }
+    if (frames == 0) {
+        return 0.0;
+    }
+
+    uint64 total = 0;
+    for (uint32 i = 1; i <= frames; i++) {
+        total += stats->samples[stat][(stats->head + stats->capacity - i) % stats->capacity];
+    }
+    return (float64)total / frames;
+}
+
+void stats_log(FrameStats *stats) {
+    if (stats->count == 0) {
+        return;
+    }
+
+    log_info("STATS: %llu frames, %llu hitches over %.3f ms.\n", (unsigned long long)stats->frames,
+             (unsigned long long)stats->hitches, stats->hitch_threshold / 1000000.0);
+    for (uint32 i = 0; i < FRAME_STAT_COUNT; i++) {
+        FrameSummary s = stats_summary(stats, (FrameStat)i);
+        log_info("    > %-6s min %.3f  mean %.3f  p50 %.3f  p95 %.3f  p99 %.3f  p99.9 %.3f  "
+                 "max %.3f ms\n",
+                 frame_stat_names[i], s.min / 1000000.0, s.mean / 1000000.0, s.p50 / 1000000.0,
+                 s.p95 / 1000000.0, s.p99 / 1000000.0, s.p999 / 1000000.0, s.max / 1000000.0);
+    }
+}
+
+// Writes the ring oldest frame first, one row per frame, all times in nanoseconds.
+bool stats_dump_csv(FrameStats *stats, const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        log_error("Unable to open %s to write frame statistics.\n", path);
+        return false;
+    }
+
+    fprintf(fp, "frame");
+    for (uint32 i = 0; i < FRAME_STAT_COUNT; i++) {
+        fprintf(fp, ",%s_ns", frame_stat_names[i]);
+    }
+    fprintf(fp, "\n");
+
+    uint64 first_frame = stats->frames - stats->count;
+    uint32 oldest = (stats->head + stats->capacity - stats->count) % stats->capacity;
+    for (uint32 n = 0; n < stats->count; n++) {
+        uint32 slot = (oldest + n) % stats->capacity;
+        fprintf(fp, "%llu", (unsigned long long)(first_frame + n));
+        for (uint32 i = 0; i < FRAME_STAT_COUNT; i++) {
+            fprintf(fp, ",%llu", (unsigned long long)stats->samples[i][slot]);
+        }
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+
+    log_info("STATS: Wrote %u frames to %s\n", stats->count, path);
+    return true;
+}
+
+void stats_destroy(FrameStats *stats) {
+    for (uint32 i = 0; i < FRAME_STAT_COUNT; i++) {
+        free(stats->samples[i]);
+        stats->samples[i] = NULL;
+    }
+    free(stats->scratch);
+    stats->scratch = NULL;
+    stats->capacity = stats->count = stats->head = 0;
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "kaneda/kaneda.h"
 
 #include <stdio.h>
+#include <string.h>
 
 void game_init() {
     log_info("game_init() called!\n");
@@ -24,10 +25,29 @@ int32_t main(int32_t argv, char **argc) {
                 .shutdown = game_shutdown,
                 .flags = {.is_fullscreen = false, .is_resizable = true, .vsync_on = true},
                 .frame_rate = 60.0f,
+                .tick_rate = 30.0f,
                 .window_width = 800,
                 .window_height = 600,
                 .window_title = "rpg"};
 
+    for (int32_t i = 1; i < argv; i++) {
+        if (strcmp(argc[i], "--headless") == 0) {
+            rpg.flags.is_headless = true;
+        } else if (strcmp(argc[i], "--virtual-clock") == 0) {
+            rpg.flags.use_virtual_clock = true;
+        } else if (strcmp(argc[i], "--sim-thread") == 0) {
+            rpg.flags.use_sim_thread = true;
+        } else if (strcmp(argc[i], "--hot-reload") == 0) {
+            rpg.flags.use_hot_reload = true;
+        } else if (strcmp(argc[i], "--record") == 0 && i + 1 < argv) {
+            rpg.record_path = argc[++i];
+        } else if (strcmp(argc[i], "--replay") == 0 && i + 1 < argv) {
+            rpg.replay_path = argc[++i];
+        } else if (strcmp(argc[i], "--pack") == 0 && i + 1 < argv) {
+            rpg.pack_path = argc[++i];
+        }
+    }
+
     Engine *e = engine_create(rpg);
 
     while (game_is_running()) {
@@ -45,6 +65,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pScmdline,
                 .shutdown = game_shutdown,
                 .flags = {.is_fullscreen = false, .is_resizable = true, .vsync_on = true},
                 .frame_rate = 60.0f,
+                .tick_rate = 30.0f,
                 .window_width = 800,
                 .window_height = 600,
                 .window_title = "rpg"};
@@ -26,7 +26,7 @@ static inline bool renderer_init(const uint32 w, const uint32 h) {
 
     glEnable(GL_DEPTH_TEST);
 
-    if (!shader_create(&shader, "shaders/simple.vert", "shaders/simple.frag", NULL)) {
+    if (!shader_create(&shader, "shaders/simple.vert", "shaders/simple.frag", NULL, NULL)) {
         log_fatal("Couldn't create the shader.\n");
         return false;
     }
@@ -123,6 +123,8 @@ static inline bool renderer_init(const uint32 w, const uint32 h) {
 }
 
 static inline void renderer_draw_frame() {
+    graphics_pass_begin("scene");
+
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -133,28 +135,32 @@ static inline void renderer_draw_frame() {
 
     shader_use(&shader);
 
-    // pass projection to shader
-    mat4 projection = math_mat4_identity();
-    projection = math_perspective(
+    // projection and camera/view transformation go in the Frame block
+    FrameUniforms frame = {0};
+    frame.projection = math_perspective(
         camera.zoom, (float)CORE.Window.render_size.width / (float)CORE.Window.render_size.height,
         0.1f, 100.0f);
-    // projection = math_orthographic(-10.0f, 10.0f, -10.0f, 10.0f, 0.0f, 100.0f);
-    shader_set_mat4(&shader, "projection", &projection.elements);
-
-    // camera/view transformation
-    mat4 view = camera_get_view_matrix(&camera);
-    shader_set_mat4(&shader, "view", &view.elements);
-
-    glBindVertexArray(CORE.Renderer.vao);
+    // frame.projection = math_orthographic(-10.0f, 10.0f, -10.0f, 10.0f, 0.0f, 100.0f);
+    frame.view = camera_get_view_matrix(&camera);
+    frame.view_projection = math_mat4_multiply(frame.projection, frame.view);
 
-    mat4 model = math_mat4_identity();
-    model = math_translate(CORE.Renderer.cube_pos);
+    ObjectUniforms object = {0};
+    object.model = math_translate(CORE.Renderer.cube_pos);
     float angle = 20.0f;
     mat4 rotation = math_rotate(angle, math_vec3(1.0f, 0.3f, 0.5f));
-    model = math_mat4_multiply(model, rotation);
+    object.model = math_mat4_multiply(object.model, rotation);
+    object.color = (vec4){.r = 1.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f};
 
-    shader_set_mat4(&shader, "model", &model.elements);
+    graphics_uniforms_begin();
+    graphics_set_frame(&frame);
+    usize cube = graphics_push_object(&object);
+    graphics_uniforms_end();
+
+    glBindVertexArray(CORE.Renderer.vao);
+    graphics_bind_object(cube);
     glDrawArrays(GL_TRIANGLES, 0, 36);
+
+    graphics_pass_end();
 }
 
 static inline void renderer_cleanup() {
@@ -0,0 +1,217 @@
+#include "../kaneda/file.h"
+#include "../kaneda/log.h"
+#include "../kaneda/pack.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Packs directories into one asset pack, see pack.h for the layout.
+
+    pack [-a alignment] [-n] out.pak dir...
+
+Every file under the given directories goes in under its path as given, e.g. "shaders/simple.vert".
+-a sets the blob alignment (a power of two, PACK_DEFAULT_ALIGNMENT by default) and -n stores
+everything uncompressed. Entries are only compressed when that saves at least an eighth, which
+leaves already compressed formats like png and jpg alone.
+*/
+
+typedef struct PackInput {
+    char *name;
+    PackEntry entry;
+    uint8 *data; // what goes in the pack, points into the view or a compressed copy
+    file_view view;
+} PackInput;
+
+static PackInput *inputs = NULL;
+static uint32 input_count = 0;
+static uint32 input_capacity = 0;
+
+static void pack_collect(const char *directory) {
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        log_fatal("Unable to open directory %s.\n", directory);
+        exit(1);
+    }
+
+    struct dirent *item;
+    while ((item = readdir(dir)) != NULL) {
+        if (item->d_name[0] == '.') {
+            continue;
+        }
+
+        usize size = strlen(directory) + 1 + strlen(item->d_name) + 1;
+        char *path = malloc(size);
+        snprintf(path, size, "%s/%s", directory, item->d_name);
+
+        struct stat st;
+        if (stat(path, &st) != 0) {
+            log_warning("Skipping %s, unable to stat it.\n", path);
+            free(path);
+        } else if (S_ISDIR(st.st_mode)) {
+            pack_collect(path);
+            free(path);
+        } else if (S_ISREG(st.st_mode)) {
+            if (input_count == input_capacity) {
+                input_capacity = input_capacity > 0 ? input_capacity * 2 : 64;
+                inputs = realloc(inputs, input_capacity * sizeof(PackInput));
+            }
+            inputs[input_count++] = (PackInput){.name = path};
+        } else {
+            free(path);
+        }
+    }
+    closedir(dir);
+}
+
+static int pack_compare(const void *a, const void *b) {
+    return strcmp(((const PackInput *)a)->name, ((const PackInput *)b)->name);
+}
+
+static uint64 pack_align(uint64 offset, uint32 alignment) {
+    return (offset + alignment - 1) & ~(uint64)(alignment - 1);
+}
+
+int main(int argc, char **argv) {
+    uint32 alignment = PACK_DEFAULT_ALIGNMENT;
+    bool is_compressed = true;
+
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-n") == 0) {
+            is_compressed = false;
+        } else if (strcmp(argv[arg], "-a") == 0 && arg + 1 < argc) {
+            alignment = (uint32)strtoul(argv[++arg], NULL, 10);
+        } else {
+            break;
+        }
+    }
+    if (argc - arg < 2 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        fprintf(stderr, "usage: %s [-a alignment] [-n] out.pak dir...\n", argv[0]);
+        return 1;
+    }
+    const char *out_path = argv[arg++];
+    for (; arg < argc; arg++) {
+        pack_collect(argv[arg]);
+    }
+    // Sorted so the same inputs always give the same pack.
+    qsort(inputs, input_count, sizeof(PackInput), pack_compare);
+
+    uint32 bucket_count = 1;
+    while (bucket_count < input_count * 2) {
+        bucket_count *= 2;
+    }
+    PackEntry *buckets = calloc(bucket_count, sizeof(PackEntry));
+
+    uint32 names_size = 0;
+    for (uint32 i = 0; i < input_count; i++) {
+        names_size += (uint32)strlen(inputs[i].name);
+    }
+    char *names = malloc(names_size > 0 ? names_size : 1);
+
+    PackHeader header = {
+        .magic = PACK_MAGIC,
+        .version = PACK_VERSION,
+        .header_size = sizeof(PackHeader),
+        .entry_count = input_count,
+        .bucket_count = bucket_count,
+        .alignment = alignment,
+        .names_size = names_size,
+        .names_offset = sizeof(PackHeader) + (uint64)bucket_count * sizeof(PackEntry),
+    };
+    header.data_offset = pack_align(header.names_offset + names_size, alignment);
+
+    uint64 offset = header.data_offset;
+    uint64 raw_total = 0;
+    uint32 name_offset = 0;
+    for (uint32 i = 0; i < input_count; i++) {
+        PackInput *input = &inputs[i];
+        usize name_size = strlen(input->name);
+        if (name_size > 0xFFFF) {
+            log_fatal("%s has too long a name for a pack.\n", input->name);
+            return 1;
+        }
+        input->view = file_map(input->name);
+        if (input->view == NULL) {
+            log_fatal("Unable to read %s.\n", input->name);
+            return 1;
+        }
+
+        usize raw_size = file_view_size(input->view);
+        input->data = (uint8 *)file_view_data(input->view);
+        input->entry = (PackEntry){
+            .hash = pack_hash(input->name, name_size),
+            .size = raw_size,
+            .raw_size = raw_size,
+            .name_offset = name_offset,
+            .name_size = (uint16)name_size,
+            .compression = PACK_COMPRESSION_NONE,
+        };
+        memcpy(names + name_offset, input->name, name_size);
+        name_offset += (uint32)name_size;
+
+        if (is_compressed && raw_size > 0) {
+            usize capacity = pack_compress_bound(raw_size);
+            uint8 *block = malloc(capacity);
+            usize size = pack_compress(input->data, raw_size, block, capacity);
+            if (size > 0 && size <= raw_size - raw_size / 8) {
+                input->data = block;
+                input->entry.size = size;
+                input->entry.compression = PACK_COMPRESSION_LZ4;
+            } else {
+                free(block);
+            }
+        }
+
+        input->entry.offset = offset;
+        offset = pack_align(offset + input->entry.size, alignment);
+        raw_total += raw_size;
+
+        uint32 mask = bucket_count - 1;
+        uint32 bucket = (uint32)input->entry.hash & mask;
+        while (buckets[bucket].hash != 0) {
+            bucket = (bucket + 1) & mask;
+        }
+        buckets[bucket] = input->entry;
+    }
+    header.total_size = input_count > 0 ? inputs[input_count - 1].entry.offset +
+                                              inputs[input_count - 1].entry.size
+                                        : header.data_offset;
+
+    file out = file_open(out_path, FILE_MODE_WRITE_BINARY);
+    file_write(out, 0, sizeof(PackHeader), &header);
+    file_write(out, sizeof(PackHeader), (uint64)bucket_count * sizeof(PackEntry), buckets);
+    file_write(out, header.names_offset, names_size, names);
+    for (uint32 i = 0; i < input_count; i++) {
+        PackInput *input = &inputs[i];
+        // file_write() won't skip past the end of the file, so the alignment padding is written.
+        uint64 end = file_get_size(out);
+        if (input->entry.offset > end) {
+            uint8 zero[4096] = {0};
+            for (; end < input->entry.offset; end = file_get_size(out)) {
+                uint64 gap = input->entry.offset - end;
+                file_write(out, end, gap < sizeof(zero) ? gap : sizeof(zero), zero);
+            }
+        }
+        file_write(out, input->entry.offset, input->entry.size, input->data);
+
+        printf("%-40s %10llu -> %10llu %s\n", input->name,
+               (unsigned long long)input->entry.raw_size, (unsigned long long)input->entry.size,
+               input->entry.compression == PACK_COMPRESSION_LZ4 ? "lz4" : "");
+        if (input->data != file_view_data(input->view)) {
+            free(input->data);
+        }
+        file_unmap(input->view);
+        free(input->name);
+    }
+    file_close(out);
+
+    printf("Packed %u files, %llu bytes into %s, %llu bytes.\n", input_count,
+           (unsigned long long)raw_total, out_path, (unsigned long long)header.total_size);
+    free(buckets);
+    free(names);
+    free(inputs);
+    return 0;
+}